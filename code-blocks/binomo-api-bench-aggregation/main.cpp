@@ -0,0 +1,122 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include "tools/binomo-cpp-api-tick-aggregator.hpp"
+#include "tools/binomo-cpp-api-candle-resampler.hpp"
+
+/* Скорость пакетной сборки баров из тиков (TickAggregator)
+ * и преобразования баров в бары кратного периода (CandleResampler)
+ */
+
+template<class F>
+double measure_ms(const uint32_t repeat, F f) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    for(uint32_t r = 0; r < repeat; ++r) {
+        f();
+    }
+    const auto stop = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count() / (double)repeat;
+}
+
+bool check_candles(const std::vector<binomo_api::common::Candle> &a, const std::vector<binomo_api::common::Candle> &b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); ++i) {
+        if(a[i].timestamp != b[i].timestamp ||
+            a[i].open != b[i].open ||
+            a[i].high != b[i].high ||
+            a[i].low != b[i].low ||
+            a[i].close != b[i].close ||
+            a[i].volume != b[i].volume) return false;
+    }
+    return true;
+}
+
+void bench_tick_aggregator(
+        const std::string &name,
+        const std::vector<xtime::ftimestamp_t> &timestamps,
+        const std::vector<double> &prices,
+        const std::vector<uint32_t> &periods) {
+    const uint32_t repeat = 5;
+    const uint32_t precision = 5;
+    size_t num_candles = 0;
+    const double ms = measure_ms(repeat, [&]() {
+        binomo_api::TickAggregator<> aggregator;
+        aggregator.set_volume_mode(1);
+        std::vector<std::vector<binomo_api::common::Candle>> output;
+        aggregator.aggregate(timestamps, prices, precision, periods, output);
+        num_candles = output[0].size();
+    });
+    std::cout
+        << name
+        << ": " << ms << " ms"
+        << ", " << ((double)timestamps.size() / (ms * 1000.0)) << " M ticks/s"
+        << ", candles " << num_candles
+        << std::endl;
+}
+
+void bench_resampler(
+        const std::string &name,
+        const std::vector<binomo_api::common::Candle> &candles,
+        const uint32_t period,
+        const uint32_t multiple,
+        const size_t max_threads) {
+    const uint32_t repeat = 10;
+    size_t num_candles = 0;
+    const double ms = measure_ms(repeat, [&]() {
+        std::vector<binomo_api::common::Candle> output;
+        binomo_api::CandleResampler<>::resample(candles, period, multiple, output, max_threads);
+        num_candles = output.size();
+    });
+    std::cout
+        << name
+        << ": " << ms << " ms"
+        << ", " << ((double)candles.size() / (ms * 1000.0)) << " M candles/s"
+        << ", candles " << num_candles
+        << std::endl;
+}
+
+int main() {
+    std::cout << "binomo api: aggregation benchmark" << std::endl;
+    const xtime::timestamp_t start_timestamp = xtime::get_timestamp(27,9,2020,0,0,0);
+
+    /* тики: четыре тика в секунду в течение 30 дней */
+    const size_t ticks_per_second = 4;
+    const size_t num_ticks = 30 * xtime::SECONDS_IN_DAY * ticks_per_second;
+    std::vector<xtime::ftimestamp_t> timestamps(num_ticks);
+    std::vector<double> prices(num_ticks);
+    for(size_t i = 0; i < num_ticks; ++i) {
+        timestamps[i] = (xtime::ftimestamp_t)start_timestamp + (xtime::ftimestamp_t)i / (xtime::ftimestamp_t)ticks_per_second;
+        prices[i] = 10000.0 + std::floor(std::sin((double)i * 0.001) * 5000000.0) / 100000.0;
+    }
+
+    /* проверяем, что минутные бары, собранные в пятиминутные, совпадают с пятиминутными барами из тиков */
+    {
+        binomo_api::TickAggregator<> aggregator;
+        aggregator.set_volume_mode(1);
+        std::vector<std::vector<binomo_api::common::Candle>> output;
+        aggregator.aggregate(timestamps, prices, 5, std::vector<uint32_t>{60, 300}, output);
+        std::vector<binomo_api::common::Candle> resampled;
+        binomo_api::CandleResampler<>::resample(output[0], 60, 5, resampled);
+        if(!check_candles(resampled, output[1])) {
+            std::cout << "error: resampled candles do not match" << std::endl;
+            return 0;
+        }
+    }
+
+    bench_tick_aggregator("TickAggregator, 1 period", timestamps, prices, std::vector<uint32_t>{60});
+    bench_tick_aggregator("TickAggregator, 4 periods", timestamps, prices, std::vector<uint32_t>{60, 300, 900, 3600});
+
+    /* бары: минутные бары за четыре года */
+    const size_t num_candles = 4 * 365 * xtime::SECONDS_IN_DAY / xtime::SECONDS_IN_MINUTE;
+    std::vector<binomo_api::common::Candle> candles(num_candles);
+    for(size_t i = 0; i < num_candles; ++i) {
+        const double price = 10000.0 + std::sin((double)i * 0.01) * 50.0;
+        candles[i] = binomo_api::common::Candle(price, price + 1.0, price - 1.0, price + 0.5, 1.0, start_timestamp + i * xtime::SECONDS_IN_MINUTE);
+    }
+
+    bench_resampler("CandleResampler 1m -> 1h, 1 thread", candles, xtime::SECONDS_IN_MINUTE, 60, 1);
+    bench_resampler("CandleResampler 1m -> 1h, all threads", candles, xtime::SECONDS_IN_MINUTE, 60, 0);
+    bench_resampler("CandleResampler 1m -> 4h, 1 thread", candles, xtime::SECONDS_IN_MINUTE, 240, 1);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include "tools/binomo-cpp-api-iso-time.hpp"
+
+/* Сравнение скорости xtime::convert_iso и binomo_api::IsoTimeDecoder
+ * на строках created_at из потока котировок и из исторических данных
+ */
+
+template<class F>
+double measure(const std::vector<std::string> &dates, const uint32_t repeat, F f) {
+    const auto start = std::chrono::high_resolution_clock::now();
+    for(uint32_t r = 0; r < repeat; ++r) {
+        for(size_t i = 0; i < dates.size(); ++i) {
+            f(dates[i]);
+        }
+    }
+    const auto stop = std::chrono::high_resolution_clock::now();
+    const double ns = std::chrono::duration<double, std::nano>(stop - start).count();
+    return ns / ((double)dates.size() * (double)repeat);
+}
+
+void bench(const std::string &name, const std::vector<std::string> &dates) {
+    const uint32_t repeat = 20;
+    volatile double sink = 0;
+
+    /* проверяем, что результаты совпадают */
+    binomo_api::IsoTimeDecoder check_decoder;
+    for(size_t i = 0; i < dates.size(); ++i) {
+        xtime::DateTime date_time;
+        xtime::ftimestamp_t ftimestamp = 0;
+        if(!xtime::convert_iso(dates[i], date_time) ||
+            !check_decoder.decode(dates[i], ftimestamp) ||
+            date_time.get_timestamp() != (xtime::timestamp_t)ftimestamp) {
+            std::cout << "error: " << dates[i] << std::endl;
+            return;
+        }
+    }
+
+    const double ns_xtime = measure(dates, repeat, [&](const std::string &str) {
+        xtime::DateTime date_time;
+        if(xtime::convert_iso(str, date_time)) sink = sink + date_time.get_ftimestamp();
+    });
+
+    binomo_api::IsoTimeDecoder decoder;
+    const double ns_decoder = measure(dates, repeat, [&](const std::string &str) {
+        xtime::ftimestamp_t ftimestamp = 0;
+        if(decoder.decode(str, ftimestamp)) sink = sink + ftimestamp;
+    });
+
+    std::cout
+        << name
+        << ": xtime::convert_iso " << ns_xtime << " ns"
+        << ", IsoTimeDecoder " << ns_decoder << " ns"
+        << ", x" << (ns_xtime / ns_decoder)
+        << std::endl;
+}
+
+int main() {
+    std::cout << "binomo api: iso time benchmark" << std::endl;
+    const xtime::timestamp_t start_timestamp = xtime::get_timestamp(27,9,2020,0,0,0);
+    const size_t num_symbols = 8;
+
+    /* тики: несколько символов с одной и той же секундой */
+    std::vector<std::string> tick_dates;
+    for(xtime::timestamp_t t = start_timestamp; t < start_timestamp + xtime::SECONDS_IN_DAY; ++t) {
+        const std::string str = xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", t) + ".000000Z";
+        for(size_t s = 0; s < num_symbols; ++s) {
+            tick_dates.push_back(str);
+        }
+    }
+    bench("ticks", tick_dates);
+
+    /* история: строго возрастающие минутные бары */
+    std::vector<std::string> history_dates;
+    for(xtime::timestamp_t t = start_timestamp; t < start_timestamp + 10 * xtime::SECONDS_IN_DAY; t += xtime::SECONDS_IN_MINUTE) {
+        history_dates.push_back(xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", t) + ".000000Z");
+    }
+    bench("history", history_dates);
+    return 0;
+}
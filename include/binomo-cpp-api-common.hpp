@@ -24,11 +24,18 @@
 #ifndef BINOMO_CPP_API_COMMON_HPP_INCLUDED
 #define BINOMO_CPP_API_COMMON_HPP_INCLUDED
 
+/* библиотека использует std::string_view, if constexpr и std::void_t */
+#if (defined(_MSVC_LANG) && _MSVC_LANG < 201703L) || (!defined(_MSVC_LANG) && __cplusplus < 201703L)
+#error "binomo-cpp-api requires C++17 (-std=c++17)"
+#endif
+
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <mutex>
 #include <algorithm>
+#include <string_view>
+#include <cmath>
 #include <nlohmann/json.hpp>
 #include "tools/base36.h"
 #include "xtime.hpp"
@@ -53,6 +60,8 @@ namespace binomo_api {
             NO_RESPONSE_WAITING_PERIOD = -11,
             INVALID_PARAMETER = -12,
             NO_PRICE_STREAM_SUBSCRIPTION = -13,
+            UNSUPPORTED_MESSAGE = -14,          ///< Сообщение не поддерживается специализированным парсером
+            SYMBOL_LIMIT_REACHED = -15,         ///< Достигнуто максимальное количество символов потока котировок
         };
 
         /** \brief Класс для хранения бара
@@ -105,17 +114,145 @@ namespace binomo_api {
             }
         };
 
+        /** \brief Класс для хранения бара с ценами в фиксированной точке
+         *
+         * Цены хранятся как целые числа в пунктах: цена * 10^precision,
+         * объем - целое количество тиков или пунктов.
+         * Точность символа берется из normalize_name_to_precision и в баре не хранится.
+         * Для преобразования цен используйте set_candle_price и get_candle_price
+         */
+        class FixedCandle {
+        public:
+            int64_t open;
+            int64_t high;
+            int64_t low;
+            int64_t close;
+            int64_t volume;
+            xtime::timestamp_t timestamp;
+
+            FixedCandle() :
+                open(0),
+                high(0),
+                low (0),
+                close(0),
+                volume(0),
+                timestamp(0) {
+            };
+
+            FixedCandle(
+                    const int64_t &new_open,
+                    const int64_t &new_high,
+                    const int64_t &new_low,
+                    const int64_t &new_close,
+                    const uint64_t &new_timestamp) :
+                open(new_open),
+                high(new_high),
+                low (new_low),
+                close(new_close),
+                volume(0),
+                timestamp(new_timestamp) {
+            }
+
+            FixedCandle(
+                    const int64_t &new_open,
+                    const int64_t &new_high,
+                    const int64_t &new_low,
+                    const int64_t &new_close,
+                    const int64_t &new_volume,
+                    const uint64_t &new_timestamp) :
+                open(new_open),
+                high(new_high),
+                low (new_low),
+                close(new_close),
+                volume(new_volume),
+                timestamp(new_timestamp) {
+            }
+        };
+
+        /** \brief Получить 10 в степени precision
+         * \param precision Количество знаков после запятой
+         * \return Множитель для перевода цены в пункты
+         */
+        inline double get_pow10(const uint32_t precision) {
+            static const double pow10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+            };
+            if(precision < (sizeof(pow10) / sizeof(pow10[0]))) return pow10[precision];
+            return std::pow(10.0, precision);
+        }
+
+        /** \brief Записать цену в поле бара
+         *
+         * Функции перегружены по типу поля бара, поэтому классы
+         * API работают одинаково с Candle и с FixedCandle
+         * \param value Поле бара
+         * \param price Цена
+         * \param precision Количество знаков после запятой
+         */
+        inline void set_candle_price(double &value, const double price, const uint32_t /*precision*/) {
+            value = price;
+        }
+
+        inline void set_candle_price(int64_t &value, const double price, const uint32_t precision) {
+            value = std::llround(price * get_pow10(precision));
+        }
+
+        /** \brief Получить цену из поля бара
+         * \param value Поле бара
+         * \param precision Количество знаков после запятой
+         * \return Цена
+         */
+        inline double get_candle_price(const double value, const uint32_t /*precision*/) {
+            return value;
+        }
+
+        inline double get_candle_price(const int64_t value, const uint32_t precision) {
+            return (double)value / get_pow10(precision);
+        }
+
+        /** \brief Получить изменение цены в пунктах
+         * \param diff Модуль изменения цены в единицах поля бара
+         * \param precision Количество знаков после запятой
+         * \return Изменение цены в пунктах
+         */
+        inline double get_candle_points(const double diff, const uint32_t precision) {
+            return get_pow10(precision) * diff + 0.5d;
+        }
+
+        inline int64_t get_candle_points(const int64_t diff, const uint32_t /*precision*/) {
+            return diff;
+        }
+
         /** \brief Класс для хранения данных тика
+         *
+         * Имя символа указывает на строку в реестре символов потока котировок
+         * и действительно, пока существует поток
          */
         class StreamTick {
         public:
-            std::string symbol;
+            std::string_view symbol;
+            uint32_t symbol_id = 0;
             double price = 0;
             xtime::ftimestamp_t timestamp = 0;
             uint32_t precision = 0;
             StreamTick() {};
         };
 
+        /** \brief Последнее состояние потока котировок символа
+         */
+        template<class CANDLE = Candle>
+        class StreamQuote {
+        public:
+            uint32_t symbol_id = 0;
+            uint32_t period = 0;
+            double price = 0;                       /**< Последняя цена bid */
+            xtime::ftimestamp_t timestamp = 0;      /**< Метка времени сервера последнего тика */
+            CANDLE candle;                          /**< Последний бар периода */
+            size_t num_candles = 0;                 /**< Количество баров периода */
+            StreamQuote() {};
+        };
+
         /** \brief Параметры символов
          */
         class SymbolConfig {
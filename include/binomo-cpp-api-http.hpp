@@ -25,6 +25,8 @@
 #define BINOMO_CPP_API_HTTP_HPP_INCLUDED
 
 #include "binomo-cpp-api-common.hpp"
+#include "tools/binomo-cpp-api-candle-resampler.hpp"
+#include "tools/binomo-cpp-api-iso-time.hpp"
 #include <curl/curl.h>
 #include <gzip/decompress.hpp>
 #include <nlohmann/json.hpp>
@@ -551,23 +553,25 @@ namespace binomo_api {
 
         void parse_history(
                 std::vector<CANDLE> &candles,
-                std::string &response) {
+                std::string &response,
+                const uint32_t precision) {
             try {
                 json j = json::parse(response);
 				if(j["success"] != true) return;
+				IsoTimeDecoder iso_decoder;
 				json j_data = j["data"];
                 const size_t size_data = j_data.size();
                 for(size_t i = 0; i < size_data; ++i) {
                     json j_canlde = j_data[i];
 					CANDLE candle;
                     std::string str_iso = j_canlde["created_at"];
-                    xtime::DateTime date_time;
-					if(!xtime::convert_iso(str_iso, date_time)) continue;
-                    candle.timestamp = date_time.get_timestamp();
-                    candle.open = j_canlde["open"];//std::atof(std::string(j_canlde["open"]).c_str());
-                    candle.high = j_canlde["high"];//std::atof(std::string(j_canlde["high"]).c_str());
-                    candle.low = j_canlde["low"];//std::atof(std::string(j_canlde["low"]).c_str());
-                    candle.close = j_canlde["close"];//std::atof(std::string(j_canlde["close"]).c_str());
+                    xtime::timestamp_t timestamp = 0;
+					if(!iso_decoder.decode(str_iso, timestamp)) continue;
+                    candle.timestamp = timestamp;
+                    common::set_candle_price(candle.open, j_canlde["open"], precision);
+                    common::set_candle_price(candle.high, j_canlde["high"], precision);
+                    common::set_candle_price(candle.low, j_canlde["low"], precision);
+                    common::set_candle_price(candle.close, j_canlde["close"], precision);
                     candle.volume = 0;
                     candles.push_back(candle);
                 }
@@ -576,23 +580,25 @@ namespace binomo_api {
 
         void parse_history(
                 std::map<xtime::timestamp_t, CANDLE> &candles,
-                std::string &response) {
+                std::string &response,
+                const uint32_t precision) {
 			try {
                 json j = json::parse(response);
 				if(j["success"] != true) return;
+				IsoTimeDecoder iso_decoder;
 				json j_data = j["data"];
                 const size_t size_data = j_data.size();
                 for(size_t i = 0; i < size_data; ++i) {
                     json j_canlde = j_data[i];
 					CANDLE candle;
 					std::string str_iso = j_canlde["created_at"];
-                    xtime::DateTime date_time;
-					if(!xtime::convert_iso(str_iso, date_time)) continue;
-                    candle.timestamp = date_time.get_timestamp();
-                    candle.open = j_canlde["open"];//std::atof(std::string(j_canlde["open"]).c_str());
-                    candle.high = j_canlde["high"];//std::atof(std::string(j_canlde["high"]).c_str());
-                    candle.low = j_canlde["low"];//std::atof(std::string(j_canlde["low"]).c_str());
-                    candle.close = j_canlde["close"];//std::atof(std::string(j_canlde["close"]).c_str());
+                    xtime::timestamp_t timestamp = 0;
+					if(!iso_decoder.decode(str_iso, timestamp)) continue;
+                    candle.timestamp = timestamp;
+                    common::set_candle_price(candle.open, j_canlde["open"], precision);
+                    common::set_candle_price(candle.high, j_canlde["high"], precision);
+                    common::set_candle_price(candle.low, j_canlde["low"], precision);
+                    common::set_candle_price(candle.close, j_canlde["close"], precision);
                     candle.volume = 0;
                     candles[(uint64_t)candle.timestamp] = candle;
                 }
@@ -664,10 +670,52 @@ namespace binomo_api {
             return err;
         }
 
+        /** \brief Получить исторические данные периода, которого нет у брокера
+         *
+         * Загружаются бары самого старшего периода брокера, на который делится period,
+         * и из них собираются бары периода period, например 4h из часовых баров
+         * \param candles Массив баров
+         * \param symbol Имя символа
+         * \param period Период
+         * \param start_date Начальная дата загрузки
+         * \param stop_date Конечная дата загрузки
+         * \return Код ошибки
+         */
+        int get_resampled_historical_data(
+                std::vector<CANDLE> &candles,
+                const std::string &symbol,
+                const uint32_t period,
+                const xtime::timestamp_t start_date,
+                const xtime::timestamp_t stop_date) {
+            const std::array<uint32_t, 11> periods = {
+                xtime::SECONDS_IN_DAY,
+                3*xtime::SECONDS_IN_HOUR,
+                xtime::SECONDS_IN_HOUR,
+                30 * xtime::SECONDS_IN_MINUTE,
+                15 * xtime::SECONDS_IN_MINUTE,
+                5 * xtime::SECONDS_IN_MINUTE,
+                xtime::SECONDS_IN_MINUTE,
+                30, 15, 5, 1
+            };
+            for(const uint32_t base_period : periods) {
+                if(period <= base_period || (period % base_period) != 0) continue;
+                std::vector<CANDLE> base_candles;
+                int err = get_historical_data(base_candles, symbol, base_period, start_date, stop_date);
+                if(err != common::OK) return err;
+                std::vector<CANDLE> temp;
+                err = CandleResampler<CANDLE>::resample(base_candles, base_period, period / base_period, temp);
+                if(err != common::OK) return err;
+                candles.insert(candles.end(), temp.begin(), temp.end());
+                return common::OK;
+            }
+            return common::DATA_NOT_AVAILABLE;
+        }
+
     public:
 
         /** \brief Получить исторические данные
          *
+         * Периоды, которых нет у брокера, собираются из баров меньшего кратного периода
          * \param candles Массив баров
          * \param symbol Имя символа
          * \param period Период
@@ -684,6 +732,9 @@ namespace binomo_api {
             std::string s = common::normalize_symbol_name(symbol);
 			auto it = common::normalize_name_to_ric.find(s);
             if(it == common::normalize_name_to_ric.end()) return common::DATA_NOT_AVAILABLE;
+            auto it_precision = common::normalize_name_to_precision.find(s);
+            const uint32_t precision = it_precision == common::normalize_name_to_precision.end() ?
+                0 : it_precision->second;
 
 			xtime::timestamp_t time_period = 0;
 			switch(period) {
@@ -691,6 +742,10 @@ namespace binomo_api {
             case 5:
             case 15:
             case 30:
+                /* секундные бары загружаем по часу, а не по целому дню */
+                start_date = start_date - (start_date % xtime::SECONDS_IN_HOUR);
+                time_period = xtime::SECONDS_IN_HOUR;
+                break;
             case xtime::SECONDS_IN_MINUTE:
                 start_date = xtime::get_first_timestamp_day(start_date);
                 time_period = xtime::SECONDS_IN_DAY;
@@ -718,7 +773,7 @@ namespace binomo_api {
                 start_date = start_date - (start_date % (xtime::SECONDS_IN_DAY*1536));
                 break;
             default:
-                return common::DATA_NOT_AVAILABLE;
+                return get_resampled_historical_data(candles, symbol, period, start_date, stop_date);
                 break;
 			}
 			xtime::timestamp_t current_date = start_date;
@@ -737,16 +792,27 @@ namespace binomo_api {
                 int err = get_request_none_security(response, url);
                 if(err != common::OK) return err;
                 std::vector<CANDLE> temp;
-                parse_history(temp, response);
+                parse_history(temp, response, precision);
 
                 //if(temp.size() > 0) {
                 //    std::cout << xtime::get_str_date_time(temp.front().timestamp) << std::endl;
                 //    std::cout << xtime::get_str_date_time(temp.back().timestamp) << std::endl;
                 //}
 
-                candles.insert(candles.end(), temp.begin(), temp.end());
+                /* соседние запросы могут вернуть одни и те же бары */
+                for(const CANDLE &candle : temp) {
+                    if(!candles.empty() && candle.timestamp <= candles.back().timestamp) continue;
+                    candles.push_back(candle);
+                }
                 if(candles.size() > 0) if(candles.back().timestamp >= stop_date) break;
                 current_date += time_period;
+                if(time_period != 0 && !temp.empty()) {
+                    /* сервер вернул больше одного окна, продолжаем с окна последнего бара */
+                    const xtime::timestamp_t last_date = temp.back().timestamp - (temp.back().timestamp % time_period);
+                    if(last_date > current_date) current_date = last_date;
+                }
+                /* дальше конечной даты данных нет, например в выходные */
+                if(time_period != 0 && current_date > stop_date) break;
                 //if(temp.back().timestamp >= stop_date) return;
             }
 
@@ -25,6 +25,19 @@
 #define BINOMO_CPP_API_WEBSOCKET_HPP_INCLUDED
 
 #include "binomo-cpp-api-common.hpp"
+#include "tools/binomo-cpp-api-assets-parser.hpp"
+#include "tools/binomo-cpp-api-candle-archive.hpp"
+#include "tools/binomo-cpp-api-candle-matrix.hpp"
+#include "tools/binomo-cpp-api-candle-ring.hpp"
+#include "tools/binomo-cpp-api-candle-snapshot.hpp"
+#include "tools/binomo-cpp-api-candle-view.hpp"
+#include "tools/binomo-cpp-api-dispatch-queue.hpp"
+#include "tools/binomo-cpp-api-ordered-executor.hpp"
+#include "tools/binomo-cpp-api-subscriber-registry.hpp"
+#include "tools/binomo-cpp-api-seqlock.hpp"
+#include "tools/binomo-cpp-api-shard-pool.hpp"
+#include "tools/binomo-cpp-api-stream-policy.hpp"
+#include "tools/binomo-cpp-api-symbol-registry.hpp"
 #include "client_wss.hpp"
 #include <openssl/ssl.h>
 #include <wincrypt.h>
@@ -33,6 +46,8 @@
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <condition_variable>
+#include <type_traits>
 #include <cstdlib>
 //#include "utf8.h" // http://utfcpp.sourceforge.net/
 
@@ -45,8 +60,20 @@ namespace binomo_api {
     //using namespace common;
 
     /** \brief Класс потока котировок для торговли Фьючерсами
+     *
+     * Политика объема и приемники баров и тиков задаются параметрами шаблона.
+     * По умолчанию режим объема выбирается через set_volume_mode(),
+     * а данные передаются в функции обратного вызова on_candle, on_tick и т.д.
+     * \tparam CANDLE Тип бара: common::Candle или common::FixedCandle
+     * \tparam VOLUME Политика объема: VolumeRuntimePolicy, VolumeNonePolicy, VolumeTickPolicy или VolumeWeightPolicy
+     * \tparam CANDLE_SINK Приемник баров, FunctionSink - функции обратного вызова
+     * \tparam TICK_SINK Приемник тиков, FunctionSink - функции обратного вызова
      */
-    template<class CANDLE = common::Candle>
+    template<
+        class CANDLE = common::Candle,
+        class VOLUME = VolumeRuntimePolicy,
+        class CANDLE_SINK = FunctionSink,
+        class TICK_SINK = FunctionSink>
     class BinomoApiPriceStream {
     private:
         using WssClient = SimpleWeb::SocketClient<SimpleWeb::WSS>;
@@ -59,26 +86,156 @@ namespace binomo_api {
         std::future<void> client_future;		/**< Поток соединения */
         std::mutex save_connection_mutex;
 
-        std::map<std::string, std::list<uint32_t>> list_subscriptions;
+        SymbolRegistry symbol_registry;         /**< Реестр символов, назначает символам идентификаторы при подписке */
+
+        std::array<std::vector<uint32_t>, SymbolRegistry::MAX_SYMBOLS> list_subscriptions;  /**< Периоды баров по идентификатору символа */
         std::mutex list_subscriptions_mutex;
+        std::atomic<uint64_t> subscriptions_version = ATOMIC_VAR_INIT(1);  /**< Версия подписок, меняется при изменении периодов */
 
         //std::map<std::string, common::SymbolConfig> symbols_config;
         //std::mutex symbols_config_mutex;
 
-        using candle_data = std::map<xtime::timestamp_t, CANDLE>;
+        using candle_data = CandleRing<CANDLE>;
+        using price_type = decltype(CANDLE::close);  /**< Тип цены бара: double или целое в пунктах */
         using period_data = std::map<uint32_t, candle_data>;
-        std::map<std::string, period_data> candles;
-        std::mutex candles_mutex;
+        std::array<period_data, SymbolRegistry::MAX_SYMBOLS> candles;  /**< Бары по идентификатору символа */
+        std::array<std::mutex, SymbolRegistry::MAX_SYMBOLS> candles_mutex;  /**< Блокировка баров по идентификатору символа */
+        std::array<std::map<uint32_t, CandleArchive<CANDLE>>, SymbolRegistry::MAX_SYMBOLS> archives;  /**< Сжатые вытесненные бары, защищены блокировкой баров символа */
+        std::array<std::map<uint32_t, CandleViewBuilder<CANDLE>>, SymbolRegistry::MAX_SYMBOLS> candle_views;  /**< Построители снимков истории, защищены блокировкой баров символа */
+
+        class PublishedPeriod;
+
+        /** \brief Период в плане каскадной агрегации
+         */
+        class CascadeCursor {
+        public:
+            uint32_t period = 0;
+            candle_data *period_candles = nullptr;  /**< Буфер баров периода, nullptr - буфера еще нет */
+            PublishedPeriod *published = nullptr;   /**< Ячейка публикации последнего бара, nullptr - еще не найдена */
+            xtime::timestamp_t bar_timestamp = 0;   /**< Метка времени бара последнего тика */
+            bool is_multiple = false;               /**< Период кратен младшему периоду символа */
+            xtime::timestamp_t closed_timestamp = 0;    /**< Метка времени последнего закрытого бара */
+            xtime::timestamp_t synced_timestamp = 0;    /**< Бар младшего периода, все тики которого попали и в бар периода */
+        };
+
+        /** \brief План каскадной агрегации символа
+         */
+        class Cascade {
+        public:
+            uint64_t version = 0;                   /**< Версия подписок, по которой построен план, 0 - план не построен */
+            uint32_t base_period = 0;               /**< Младший период символа */
+            size_t base_index = 0;                  /**< Индекс младшего периода в плане */
+            xtime::timestamp_t base_bar_timestamp = 0;
+            std::vector<CascadeCursor> cursors;     /**< Периоды в порядке подписки */
+        };
+
+        std::array<Cascade, SymbolRegistry::MAX_SYMBOLS> cascades;  /**< Планы каскадной агрегации, защищены блокировкой баров символа */
+
+        std::future<void> bar_close_future;     /**< Поток закрытия баров по времени сервера */
+        std::mutex bar_close_mutex;
+        std::condition_variable bar_close_condition;
+        std::atomic<bool> is_bar_close_timer = ATOMIC_VAR_INIT(false);  /**< Бары закрываются по времени сервера, а не по первому тику следующего бара */
+
+        /** \brief Параметры хранения баров периода
+         */
+        class Retention {
+        public:
+            size_t max_candles = 0;     /**< Максимальное количество баров, 0 - без ограничений */
+            uint32_t tier_period = 0;   /**< Период, в который сворачиваются вытесненные бары, 0 - не сворачивать */
+            bool is_compressed = false; /**< Флаг сжатия вытесненных баров */
+        };
+
+        std::map<uint32_t, Retention> retention;                    /**< Параметры хранения баров по периодам */
+        std::mutex retention_mutex;
+        std::atomic<size_t> memory_budget = ATOMIC_VAR_INIT(0);     /**< Ограничение памяти под бары в байтах, 0 - без ограничений */
+        std::atomic<size_t> total_candles = ATOMIC_VAR_INIT(0);     /**< Количество хранимых баров всех символов */
+        std::mutex memory_budget_mutex;                             /**< Общее ограничение памяти применяет один поток */
+
+        static const size_t MAX_PUBLISHED_PERIODS = 16;  /**< Максимальное количество периодов символа, публикуемых через seqlock */
+
+        /** \brief Последний бар периода и количество баров
+         */
+        class PublishedCandle {
+        public:
+            CANDLE candle;
+            size_t num_candles = 0;
+        };
+
+        /** \brief Ячейка публикации последнего бара периода
+         *
+         * Ячейка занимается один раз и больше не освобождается
+         */
+        class PublishedPeriod {
+        public:
+            std::atomic<uint32_t> period;   /**< Период, 0 - ячейка свободна */
+            SeqLock<PublishedCandle> value;
+            PublishedPeriod() : period(0) {};
+        };
+
+        /** \brief Последний тик символа
+         */
+        class PublishedTick {
+        public:
+            double price = 0;
+            xtime::ftimestamp_t timestamp = 0;
+        };
+
+        /** \brief Последние бары по идентификатору символа, пишутся под блокировкой баров символа */
+        std::array<std::array<PublishedPeriod, MAX_PUBLISHED_PERIODS>, SymbolRegistry::MAX_SYMBOLS> published_candles;
+        /** \brief Последние тики по идентификатору символа, пишутся только из потока вебсокета */
+        std::array<SeqLock<PublishedTick>, SymbolRegistry::MAX_SYMBOLS> published_ticks;
+
+        TickJournal tick_journal;               /**< Журнал тиков после последнего снимка */
+        std::mutex tick_journal_mutex;
+        std::mutex snapshot_mutex;              /**< Снимки записываются по одному */
+        std::atomic<bool> is_tick_journal = ATOMIC_VAR_INIT(false);
+        std::atomic<bool> is_replay = ATOMIC_VAR_INIT(false);    /**< Флаг восстановления баров из журнала, функции обратного вызова не вызываются */
+
+        ShardPool<common::StreamTick> aggregation_pool;             /**< Потоки обработки баров, разбиение по символам */
+
+        /** \brief Событие для потока доставки
+         */
+        class DispatchEvent {
+        public:
+            static const uint8_t CANDLE_EVENT = 0;
+            static const uint8_t CORRECTION_EVENT = 1;
+            static const uint8_t TICK_EVENT = 2;
+
+            uint8_t type = CANDLE_EVENT;
+            bool close_candle = false;
+            uint32_t symbol_id = 0;
+            uint32_t period = 0;
+            CANDLE candle;
+            common::StreamTick tick;
+
+            /** \brief Ключ объединения: тики символа или бары периода символа
+             */
+            inline uint64_t get_key() const {
+                if(type == TICK_EVENT) return ((uint64_t)1 << 63) | symbol_id;
+                return ((uint64_t)symbol_id << 32) | period;
+            }
+
+            /** \brief Заменять новыми можно тики и обновления незакрытых баров
+             */
+            inline bool is_conflatable() const {
+                return type == TICK_EVENT || (type == CANDLE_EVENT && !close_candle);
+            }
+        };
+
+        DispatchQueue<DispatchEvent> dispatch_queue;    /**< Очередь доставки событий в функции обратного вызова */
+        std::array<std::vector<DispatchEvent>, SymbolRegistry::MAX_SYMBOLS> dispatch_pending;  /**< События баров, еще не переданные дальше, защищены блокировкой баров символа */
+        std::array<std::mutex, SymbolRegistry::MAX_SYMBOLS> dispatch_order_mutex;  /**< Сохраняет порядок передачи событий символа в очередь */
+        OrderedExecutor<DispatchEvent> callback_executor;   /**< Параллельный вызов функций обратного вызова с порядком по символу и периоду */
+        SubscriberRegistry<CANDLE> subscribers;             /**< Подписчики на события с фильтрами по символу и периоду */
 
         std::atomic<bool> is_websocket_init;    /**< Состояние соединения */
         std::atomic<bool> is_error;             /**< Ошибка соединения */
         std::atomic<bool> is_close_connection;  /**< Флаг для закрытия соединения */
         std::atomic<bool> is_open;
 
-        std::atomic<int> volume_mode = ATOMIC_VAR_INIT(0);
-        const int MODE_NO_VOLUME = 0;
-        const int MODE_VOLUME_ACC = 1;
-        const int MODE_VOLUME_WEIGHT_ACC = 2;
+        VOLUME volume_policy;                   /**< Политика подсчета объема */
+        CANDLE_SINK candle_sink;                /**< Приемник баров */
+        TICK_SINK tick_sink;                    /**< Приемник тиков */
 
         std::string error_message;
         std::recursive_mutex error_message_mutex;
@@ -126,18 +283,962 @@ namespace binomo_api {
             save_connection->send(message);
         }
 
+        AssetsParser<> assets_parser;  /**< Парсер сообщений с тиками, используется только в потоке вебсокета */
+        IsoTimeDecoder iso_decoder;     /**< Декодер даты для обычного парсера, используется только в потоке вебсокета */
+        std::vector<common::StreamTick> json_ticks;             /**< Тики обычного парсера, используется только в потоке вебсокета */
+        std::vector<xtime::ftimestamp_t> json_ftimestamps;      /**< Метки времени тиков обычного парсера */
+
+        /** \brief Вывести ошибку регистрации символа
+         * \param symbol Имя символа
+         * \param err Код ошибки SymbolRegistry::add
+         */
+        void print_symbol_error(const std::string &symbol, const int err) {
+            if(err == common::SYMBOL_LIMIT_REACHED) {
+                std::cerr << "binomo api: symbol " << symbol << " not added, symbol limit "
+                    << SymbolRegistry::MAX_SYMBOLS << " reached!" << std::endl;
+                return;
+            }
+            std::cerr << "binomo api: symbol " << symbol << " does not exist!" << std::endl;
+        }
+
+        /** \brief Вызвать функции обратного вызова бара
+         * \param symbol_id Идентификатор символа
+         * \param candle Бар
+         * \param period Период
+         * \param close_candle Флаг закрытия бара
+         */
+        inline void deliver_candle(
+                const uint32_t symbol_id,
+                const CANDLE &candle,
+                const uint32_t period,
+                const bool close_candle) {
+            if constexpr (std::is_same<CANDLE_SINK, FunctionSink>::value) {
+                if(on_candle_id != nullptr) on_candle_id(symbol_id, candle, period, close_candle);
+                if(on_candle != nullptr) on_candle(symbol_registry.get_name(symbol_id), candle, period, close_candle);
+            } else {
+                candle_sink.on_candle(symbol_id, candle, period, close_candle);
+            }
+            subscribers.dispatch_candle(symbol_id, candle, period, close_candle);
+        }
+
+        /** \brief Вызвать функции обратного вызова исправления закрытого бара
+         * \param symbol_id Идентификатор символа
+         * \param candle Исправленный бар
+         * \param period Период
+         */
+        inline void deliver_candle_correction(
+                const uint32_t symbol_id,
+                const CANDLE &candle,
+                const uint32_t period) {
+            if constexpr (std::is_same<CANDLE_SINK, FunctionSink>::value) {
+                if(on_candle_correction != nullptr) on_candle_correction(symbol_id, candle, period);
+            } else
+            if constexpr (HasCandleCorrection<CANDLE_SINK, CANDLE>::value) {
+                candle_sink.on_candle_correction(symbol_id, candle, period);
+            }
+            subscribers.dispatch_candle_correction(symbol_id, candle, period);
+        }
+
+        /** \brief Вызвать функции обратного вызова тика
+         * \param tick Тик
+         */
+        inline void deliver_tick(const common::StreamTick &tick) {
+            if constexpr (std::is_same<TICK_SINK, FunctionSink>::value) {
+                if(on_tick != nullptr) on_tick(tick);
+            } else {
+                tick_sink.on_tick(tick);
+            }
+            subscribers.dispatch_tick(tick);
+        }
+
+        /** \brief Передать событие в функции обратного вызова
+         *
+         * Вызывается из потока доставки или потока пула обработчиков
+         * \param event Событие
+         */
+        void deliver_event(const DispatchEvent &event) {
+            switch(event.type) {
+            case DispatchEvent::CANDLE_EVENT:
+                deliver_candle(event.symbol_id, event.candle, event.period, event.close_candle);
+                break;
+            case DispatchEvent::CORRECTION_EVENT:
+                deliver_candle_correction(event.symbol_id, event.candle, event.period);
+                break;
+            case DispatchEvent::TICK_EVENT:
+                deliver_tick(event.tick);
+                break;
+            default:
+                break;
+            };
+        }
+
+        /** \brief Цепочки пула обработчиков одного символа: ячейки публикации периодов,
+         * периоды без ячейки и тики
+         */
+        static const size_t CALLBACK_STRANDS = MAX_PUBLISHED_PERIODS + 2;
+
+        /** \brief Получить цепочку пула обработчиков для события
+         *
+         * Каждый опубликованный период символа получает свою цепочку по номеру ячейки
+         * публикации, поэтому события разных символов и периодов не ждут друг друга.
+         * Ячейка занимается до первого события периода и больше не меняется.
+         * Периоды сверх MAX_PUBLISHED_PERIODS делят одну цепочку символа
+         * \param event Событие
+         * \return Номер цепочки
+         */
+        inline size_t get_callback_strand(const DispatchEvent &event) const {
+            const size_t strand = (size_t)event.symbol_id * CALLBACK_STRANDS;
+            if(event.type == DispatchEvent::TICK_EVENT) return strand + MAX_PUBLISHED_PERIODS + 1;
+            const auto &slots = published_candles[event.symbol_id];
+            for(size_t index = 0; index < MAX_PUBLISHED_PERIODS; ++index) {
+                const uint32_t slot_period = slots[index].period.load(std::memory_order_acquire);
+                if(slot_period == event.period) return strand + index;
+                if(slot_period == 0) break;
+            }
+            return strand + MAX_PUBLISHED_PERIODS;
+        }
+
+        /** \brief Проверить, вызываются ли функции обратного вызова вне потока обработки
+         */
+        inline bool is_deferred_dispatch() const {
+            return dispatch_queue.running() || callback_executor.running();
+        }
+
+        /** \brief Отложить событие бара
+         *
+         * Вызывается под блокировкой баров символа. Пул обработчиков не ждет
+         * выполнения задач, поэтому без очереди доставки событие передается в пул сразу.
+         * В остальных случаях событие ждет снятия блокировки, см. flush_dispatch
+         * \param event Событие
+         */
+        inline void defer_candle_event(const DispatchEvent &event) {
+            if(callback_executor.running() && !dispatch_queue.running()) {
+                callback_executor.push(get_callback_strand(event), event);
+            } else {
+                dispatch_pending[event.symbol_id].push_back(event);
+            }
+        }
+
+        /** \brief Передать событие из очереди доставки дальше
+         *
+         * Вызывается из потока доставки
+         * \param event Событие
+         */
+        inline void dispatch_event(const DispatchEvent &event) {
+            if(callback_executor.running()) {
+                callback_executor.push(get_callback_strand(event), event);
+            } else {
+                deliver_event(event);
+            }
+        }
+
+        /** \brief Бар или его исправление
+         *
+         * Вызывается под блокировкой баров символа, поэтому событие откладывается
+         * до снятия блокировки, см. flush_dispatch. Так функции обратного вызова
+         * могут читать бары символа и без очереди доставки.
+         * Если включен только пул обработчиков, событие передается в пул
+         * \param symbol_id Идентификатор символа
+         * \param candle Бар
+         * \param period Период
+         * \param close_candle Флаг закрытия бара
+         */
+        inline void emit_candle(
+                const uint32_t symbol_id,
+                const CANDLE &candle,
+                const uint32_t period,
+                const bool close_candle) {
+            if(is_replay) return;
+            DispatchEvent event;
+            event.type = DispatchEvent::CANDLE_EVENT;
+            event.close_candle = close_candle;
+            event.symbol_id = symbol_id;
+            event.period = period;
+            event.candle = candle;
+            defer_candle_event(event);
+        }
+
+        inline void emit_candle_correction(
+                const uint32_t symbol_id,
+                const CANDLE &candle,
+                const uint32_t period) {
+            if(is_replay) return;
+            DispatchEvent event;
+            event.type = DispatchEvent::CORRECTION_EVENT;
+            event.symbol_id = symbol_id;
+            event.period = period;
+            event.candle = candle;
+            defer_candle_event(event);
+        }
+
+        /** \brief Тик
+         *
+         * Вызывается из потока вебсокета без блокировок
+         * \param tick Тик
+         */
+        inline void emit_tick(const common::StreamTick &tick) {
+            if(!is_deferred_dispatch()) {
+                deliver_tick(tick);
+                return;
+            }
+            DispatchEvent event;
+            event.type = DispatchEvent::TICK_EVENT;
+            event.symbol_id = tick.symbol_id;
+            event.tick = tick;
+            if(dispatch_queue.running()) {
+                dispatch_queue.push(event);
+            } else {
+                callback_executor.push(get_callback_strand(event), event);
+            }
+        }
+
+        /** \brief Передать отложенные события баров символа дальше
+         *
+         * Вызывается после снятия блокировки баров символа, поэтому ожидание места
+         * в очереди не мешает функциям обратного вызова читать бары.
+         * Без очереди доставки функции обратного вызова вызываются здесь же,
+         * тоже вне блокировки баров, и могут запрашивать бары символа.
+         * Блокировка порядка сохраняет порядок событий символа,
+         * если их создают несколько потоков (поток обработки и таймер закрытия баров)
+         * \param symbol_id Идентификатор символа
+         */
+        void flush_dispatch(const uint32_t symbol_id) {
+            static thread_local std::vector<DispatchEvent> events;
+            std::lock_guard<std::mutex> order_lock(dispatch_order_mutex[symbol_id]);
+            {
+                std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                if(dispatch_pending[symbol_id].empty()) return;
+                events.swap(dispatch_pending[symbol_id]);
+            }
+            if(dispatch_queue.running()) {
+                for(const DispatchEvent &event : events) {
+                    dispatch_queue.push(event);
+                }
+            } else {
+                for(const DispatchEvent &event : events) {
+                    deliver_event(event);
+                }
+            }
+            events.clear();
+        }
+
+        /** \brief Вызвать функции обратного вызова пакета тиков
+         * \param ticks Указатель на массив тиков
+         * \param ticks_size Количество тиков
+         * \param receive_timestamp Метка времени компьютера в момент получения сообщения
+         */
+        inline void emit_ticks(
+                const common::StreamTick *ticks,
+                const size_t ticks_size,
+                const xtime::ftimestamp_t receive_timestamp) {
+            if constexpr (std::is_same<TICK_SINK, FunctionSink>::value) {
+                if(on_ticks != nullptr) on_ticks(ticks, ticks_size, receive_timestamp);
+            } else {
+                tick_sink.on_ticks(ticks, ticks_size, receive_timestamp);
+            }
+        }
+
+        /** \brief Обработать тик
+         * \param tick Тик
+         * \param ftimestamp Метка времени тика с дробной частью
+         * \param receive_timestamp Метка времени компьютера в момент получения сообщения
+         */
+        void process_tick(
+                const common::StreamTick &tick,
+                const xtime::ftimestamp_t ftimestamp,
+                const xtime::ftimestamp_t receive_timestamp) {
+            /* проверяем, не поменялась ли метка времени */
+            if(last_timestamp < ftimestamp) {
+
+                /* если метка времени поменялась, найдем время сервера */
+                xtime::ftimestamp_t offset_timestamp = ftimestamp - receive_timestamp;
+                update_offset_timestamp(offset_timestamp);
+                last_timestamp = ftimestamp;
+
+                /* запоминаем последнюю метку времени сервера */
+                last_server_timestamp = ftimestamp;
+            }
+
+            /* публикуем последний тик для читателей без блокировок */
+            PublishedTick published_tick;
+            published_tick.price = tick.price;
+            published_tick.timestamp = ftimestamp;
+            published_ticks[tick.symbol_id].store(published_tick);
+
+            /* обрабатываем функцию обратного вызова поступления тика */
+            emit_tick(tick);
+
+            /* тик попадает в журнал и в бары под одной блокировкой,
+             * поэтому снимок не может оказаться между ними
+             */
+            std::unique_lock<std::mutex> journal_lock;
+            if(is_tick_journal) {
+                journal_lock = std::unique_lock<std::mutex>(tick_journal_mutex);
+                tick_journal.write(symbol_registry.get_name(tick.symbol_id), tick.price, tick.timestamp);
+            }
+
+            if(aggregation_pool.running()) {
+                aggregation_pool.push(tick.symbol_id, tick);
+            } else {
+                aggregate_tick(tick);
+                if(journal_lock.owns_lock()) journal_lock.unlock();
+                flush_dispatch(tick.symbol_id);
+                enforce_memory_budget();
+            }
+        }
+
+        /** \brief Получить буфер баров периода, при необходимости создать его
+         *
+         * Вызывается под блокировкой баров символа
+         * \param symbol_candles Бары символа
+         * \param period Период
+         * \return Буфер баров периода
+         */
+        candle_data &get_period_candles(period_data &symbol_candles, const uint32_t period) {
+            auto it_period = symbol_candles.find(period);
+            if(it_period != symbol_candles.end()) return it_period->second;
+            candle_data &period_candles = symbol_candles[period];
+            period_candles.set_period(period);
+            std::lock_guard<std::mutex> lock(retention_mutex);
+            auto it_retention = retention.find(period);
+            if(it_retention != retention.end()) {
+                period_candles.set_max_size(it_retention->second.max_candles);
+                period_candles.set_tier_period(it_retention->second.tier_period);
+                period_candles.set_compressed(it_retention->second.is_compressed);
+            }
+            reserve_period_candles(period_candles);
+            return period_candles;
+        }
+
+        /** \brief Заранее выделить место под бары секундного периода
+         *
+         * Бары периодов меньше минуты появляются каждые несколько секунд,
+         * поэтому место под них выделяется сразу: под все бары ограничения хранения
+         * или, если ограничения нет, под час баров
+         * \param period_candles Буфер баров периода
+         */
+        inline void reserve_period_candles(candle_data &period_candles) {
+            const uint32_t period = period_candles.get_period();
+            if(period == 0 || period >= xtime::SECONDS_IN_MINUTE) return;
+            const size_t max_candles = period_candles.get_max_size();
+            period_candles.reserve(max_candles != 0 ? max_candles : xtime::SECONDS_IN_HOUR / period);
+        }
+
+        /** \brief Вытеснить самый старый бар периода
+         *
+         * Если для периода включено сжатие, вытесненный бар сохраняется в сжатом хранилище.
+         * Если для периода задан старший период хранения,
+         * вытесненный бар сворачивается в бар старшего периода
+         * \param symbol_id Идентификатор символа
+         * \param period_candles Буфер баров периода
+         */
+        void evict_candle(const uint32_t symbol_id, candle_data &period_candles) {
+            if(period_candles.empty()) return;
+            const CANDLE candle = period_candles.front();
+            period_candles.pop_front();
+            --total_candles;
+            if(period_candles.get_compressed()) {
+                get_period_archive(symbol_id, period_candles.get_period()).push_back(candle);
+            }
+            const uint32_t tier_period = period_candles.get_tier_period();
+            if(tier_period == 0) return;
+            fold_candle(symbol_id, get_period_candles(candles[symbol_id], tier_period), candle);
+        }
+
+        /** \brief Получить сжатое хранилище баров периода, создав его при необходимости
+         *
+         * Вызывается под блокировкой баров символа
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \return Сжатое хранилище баров периода
+         */
+        CandleArchive<CANDLE> &get_period_archive(const uint32_t symbol_id, const uint32_t period) {
+            auto it_archive = archives[symbol_id].find(period);
+            if(it_archive != archives[symbol_id].end()) return it_archive->second;
+            CandleArchive<CANDLE> &archive = archives[symbol_id][period];
+            archive.set_precision(symbol_registry.get_precision(symbol_id));
+            return archive;
+        }
+
+        /** \brief Найти сжатое хранилище баров периода
+         *
+         * Вызывается под блокировкой баров символа
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \return Указатель на хранилище или nullptr, если сжатых баров нет
+         */
+        inline const CandleArchive<CANDLE> *find_period_archive(const uint32_t symbol_id, const uint32_t period) const {
+            if(archives[symbol_id].empty()) return nullptr;
+            auto it_archive = archives[symbol_id].find(period);
+            if(it_archive == archives[symbol_id].end() || it_archive->second.empty()) return nullptr;
+            return &it_archive->second;
+        }
+
+        /** \brief Получить количество хранимых баров периода, включая сжатые
+         */
+        inline size_t get_stored_size(const CandleArchive<CANDLE> *archive, const candle_data &period_candles) const {
+            return (archive ? archive->size() : 0) + period_candles.size();
+        }
+
+        /** \brief Получить хранимый бар по индексу, сначала идут сжатые бары, затем бары буфера
+         */
+        inline CANDLE get_stored_candle(
+                const CandleArchive<CANDLE> *archive,
+                const candle_data &period_candles,
+                const size_t index) const {
+            const size_t archive_size = archive ? archive->size() : 0;
+            if(index < archive_size) return archive->get(index);
+            return period_candles[index - archive_size];
+        }
+
+        /** \brief Найти индекс первого хранимого бара с меткой времени не меньше заданной
+         */
+        inline size_t get_stored_lower_bound(
+                const CandleArchive<CANDLE> *archive,
+                const candle_data &period_candles,
+                const xtime::timestamp_t timestamp) const {
+            const size_t archive_size = archive ? archive->size() : 0;
+            if(archive_size != 0 && timestamp <= archive->get_last_timestamp()) {
+                return archive->lower_bound(timestamp);
+            }
+            return archive_size + period_candles.lower_bound(timestamp);
+        }
+
+        /** \brief Скопировать диапазон хранимых баров
+         * \return Количество скопированных баров
+         */
+        size_t copy_stored_candles(
+                const CandleArchive<CANDLE> *archive,
+                const candle_data &period_candles,
+                const size_t index,
+                const size_t length,
+                CANDLE *output) const {
+            const size_t archive_size = archive ? archive->size() : 0;
+            size_t n = 0;
+            if(index < archive_size) n = archive->copy(index, length, output);
+            const size_t ring_index = index + n - archive_size;
+            return n + period_candles.copy(ring_index, length - n, output + n);
+        }
+
+        /** \brief Свернуть бар в бар старшего периода
+         *
+         * Обновляется только тот бар старшего периода, который собирается
+         * из свернутых баров. Бары, полученные из потока или истории, не изменяются
+         * \param symbol_id Идентификатор символа
+         * \param tier_candles Буфер баров старшего периода
+         * \param candle Вытесненный бар
+         */
+        void fold_candle(const uint32_t symbol_id, candle_data &tier_candles, const CANDLE &candle) {
+            const uint32_t tier_period = tier_candles.get_period();
+            /* метка времени бара - время его окончания */
+            const xtime::timestamp_t timestamp = candle.timestamp - 1;
+            const xtime::timestamp_t tier_timestamp = (timestamp - (timestamp % tier_period)) + tier_period;
+            const size_t index = tier_candles.find(tier_timestamp);
+            if(index == candle_data::NONE) {
+                CANDLE tier_candle = candle;
+                tier_candle.timestamp = tier_timestamp;
+                tier_candles.set_fold_timestamp(tier_timestamp);
+                store_candle(symbol_id, tier_candles, tier_candle);
+                return;
+            }
+            if(tier_candles.get_fold_timestamp() != tier_timestamp) return;
+            CANDLE &tier_candle = tier_candles[index];
+            if(candle.high > tier_candle.high) tier_candle.high = candle.high;
+            if(candle.low < tier_candle.low) tier_candle.low = candle.low;
+            tier_candle.close = candle.close;
+            tier_candle.volume += candle.volume;
+            tier_candles.mark_modified(index);
+        }
+
+        /** \brief Сохранить новый бар с учетом ограничений хранения
+         * \param symbol_id Идентификатор символа
+         * \param period_candles Буфер баров периода
+         * \param candle Бар
+         */
+        void store_candle(const uint32_t symbol_id, candle_data &period_candles, const CANDLE &candle) {
+            if(period_candles.full()) {
+                /* бар старше всех хранимых баров уже был бы вытеснен */
+                if(candle.timestamp < period_candles.front().timestamp) return;
+                evict_candle(symbol_id, period_candles);
+            }
+            const size_t size = period_candles.size();
+            period_candles.insert(candle);
+            if(period_candles.size() > size) ++total_candles;
+            enforce_retention(symbol_id, period_candles);
+        }
+
+        /** \brief Применить ограничение количества баров периода
+         *
+         * Общее ограничение памяти здесь не проверяется, см. enforce_memory_budget
+         * \param symbol_id Идентификатор символа
+         * \param period_candles Буфер баров периода
+         */
+        inline void enforce_retention(const uint32_t symbol_id, candle_data &period_candles) {
+            while(period_candles.excess()) {
+                evict_candle(symbol_id, period_candles);
+            }
+        }
+
+        /** \brief Проверить, превышено ли общее ограничение памяти под бары
+         */
+        inline bool is_memory_budget_exceeded() const {
+            const size_t budget = memory_budget;
+            return budget != 0 && total_candles * sizeof(CANDLE) > budget;
+        }
+
+        /** \brief Применить общее ограничение памяти под бары
+         *
+         * Вытесняются самые старые бары среди буферов всех символов и периодов,
+         * в каждом буфере остается хотя бы последний бар. Буферы старших периодов,
+         * в которые сворачиваются вытесненные бары, затрагиваются в последнюю очередь.
+         * Вызывается без блокировок баров символов
+         */
+        void enforce_memory_budget() {
+            if(!is_memory_budget_exceeded()) return;
+            std::lock_guard<std::mutex> budget_lock(memory_budget_mutex);
+
+            /** \brief Буфер-кандидат на вытеснение
+             */
+            class EvictionCandidate {
+            public:
+                bool is_tier = false;               /**< В буфер сворачиваются бары младшего периода */
+                xtime::timestamp_t timestamp = 0;   /**< Метка времени самого старого бара буфера */
+                uint32_t symbol_id = 0;
+                uint32_t period = 0;
+
+                inline bool operator > (const EvictionCandidate &other) const {
+                    if(is_tier != other.is_tier) return is_tier;
+                    return timestamp > other.timestamp;
+                }
+            };
+
+            std::vector<EvictionCandidate> heap;
+            std::vector<uint32_t> tier_periods;
+            const uint32_t symbols_size = symbol_registry.size();
+            for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                tier_periods.clear();
+                for(auto &item : candles[symbol_id]) {
+                    if(item.second.get_tier_period() != 0) tier_periods.push_back(item.second.get_tier_period());
+                }
+                for(auto &item : candles[symbol_id]) {
+                    if(item.second.size() <= 1) continue;
+                    EvictionCandidate candidate;
+                    candidate.is_tier = std::find(tier_periods.begin(), tier_periods.end(), item.first) != tier_periods.end();
+                    candidate.timestamp = item.second.front().timestamp;
+                    candidate.symbol_id = symbol_id;
+                    candidate.period = item.first;
+                    heap.push_back(candidate);
+                }
+            }
+
+            /* на вершине кучи буфер с самым старым баром */
+            auto compare = [](const EvictionCandidate &a, const EvictionCandidate &b) {
+                return a > b;
+            };
+            std::make_heap(heap.begin(), heap.end(), compare);
+            while(!heap.empty() && is_memory_budget_exceeded()) {
+                std::pop_heap(heap.begin(), heap.end(), compare);
+                EvictionCandidate &candidate = heap.back();
+                {
+                    std::lock_guard<std::mutex> lock(candles_mutex[candidate.symbol_id]);
+                    auto it_period = candles[candidate.symbol_id].find(candidate.period);
+                    if(it_period != candles[candidate.symbol_id].end() && it_period->second.size() > 1) {
+                        candle_data &period_candles = it_period->second;
+                        evict_candle(candidate.symbol_id, period_candles);
+                        publish_candles(candidate.symbol_id);
+                        if(period_candles.size() > 1) {
+                            candidate.timestamp = period_candles.front().timestamp;
+                            std::push_heap(heap.begin(), heap.end(), compare);
+                            continue;
+                        }
+                    }
+                }
+                heap.pop_back();
+            }
+        }
+
+        /** \brief Опубликовать последний бар периода
+         *
+         * Вызывается под блокировкой баров символа, поэтому писатель всегда один
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \param period_candles Буфер баров периода
+         * \return Ячейка публикации или nullptr, если свободных ячеек нет
+         */
+        PublishedPeriod *publish_candle(const uint32_t symbol_id, const uint32_t period, const candle_data &period_candles) {
+            for(PublishedPeriod &slot : published_candles[symbol_id]) {
+                const uint32_t slot_period = slot.period.load(std::memory_order_relaxed);
+                if(slot_period != period && slot_period != 0) continue;
+                publish_slot(slot, symbol_id, period, period_candles);
+                return &slot;
+            }
+            return nullptr;
+        }
+
+        /** \brief Опубликовать последний бар периода в ячейку
+         *
+         * Период ячейки становится виден читателям только после значения
+         */
+        inline void publish_slot(
+                PublishedPeriod &slot,
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const candle_data &period_candles) {
+            PublishedCandle value;
+            value.num_candles = get_stored_size(find_period_archive(symbol_id, period), period_candles);
+            if(!period_candles.empty()) value.candle = period_candles.back();
+            slot.value.store(value);
+            if(slot.period.load(std::memory_order_relaxed) == 0) slot.period.store(period, std::memory_order_release);
+        }
+
+        /** \brief Опубликовать последний бар периода плана каскадной агрегации
+         *
+         * Ячейка публикации запоминается в плане, поэтому ищется один раз
+         */
+        inline void publish_cursor(const uint32_t symbol_id, CascadeCursor &cursor, const candle_data &period_candles) {
+            if(cursor.published) publish_slot(*cursor.published, symbol_id, cursor.period, period_candles);
+            else cursor.published = publish_candle(symbol_id, cursor.period, period_candles);
+        }
+
+        /** \brief Опубликовать последние бары всех периодов символа
+         * \param symbol_id Идентификатор символа
+         */
+        void publish_candles(const uint32_t symbol_id) {
+            for(auto &item : candles[symbol_id]) {
+                publish_candle(symbol_id, item.first, item.second);
+            }
+        }
+
+        /** \brief Найти опубликованный последний бар периода
+         *
+         * Метод не использует блокировки
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \return Указатель на ячейку или nullptr, если период не опубликован
+         */
+        const PublishedPeriod *find_published_candle(const uint32_t symbol_id, const uint32_t period) const {
+            for(const PublishedPeriod &slot : published_candles[symbol_id]) {
+                const uint32_t slot_period = slot.period.load(std::memory_order_acquire);
+                if(slot_period == period) return &slot;
+                if(slot_period == 0) return nullptr;
+            }
+            return nullptr;
+        }
+
+        /** \brief Построить план каскадной агрегации символа
+         *
+         * Вызывается под блокировкой баров символа
+         * \param symbol_id Идентификатор символа
+         * \param cascade План каскадной агрегации
+         * \param version Версия подписок
+         */
+        void build_cascade(const uint32_t symbol_id, Cascade &cascade, const uint64_t version) {
+            std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
+            const std::vector<uint32_t> &periods = list_subscriptions[symbol_id];
+            /* закрытые бары остаются закрытыми и после изменения подписок */
+            std::map<uint32_t, xtime::timestamp_t> closed_timestamps;
+            for(const CascadeCursor &cursor : cascade.cursors) {
+                closed_timestamps[cursor.period] = cursor.closed_timestamp;
+            }
+            cascade.cursors.clear();
+            cascade.version = version;
+            cascade.base_bar_timestamp = 0;
+            if(periods.empty()) return;
+            const auto it_base = std::min_element(periods.begin(), periods.end());
+            cascade.base_period = *it_base;
+            cascade.base_index = (size_t)(it_base - periods.begin());
+            period_data &symbol_candles = candles[symbol_id];
+            for(const uint32_t period : periods) {
+                CascadeCursor cursor;
+                cursor.period = period;
+                cursor.is_multiple = (period % cascade.base_period) == 0;
+                auto it_period = symbol_candles.find(period);
+                if(it_period != symbol_candles.end()) cursor.period_candles = &it_period->second;
+                auto it_closed = closed_timestamps.find(period);
+                if(it_closed != closed_timestamps.end()) cursor.closed_timestamp = it_closed->second;
+                cascade.cursors.push_back(cursor);
+            }
+        }
+
+        /** \brief Обновить бары по тику
+         *
+         * Пока тик попадает в тот же, последний бар младшего периода символа,
+         * тиком обновляется только этот бар: политика объема вызывается один раз,
+         * а последние бары старших периодов, кратных младшему, получают изменения
+         * бара младшего периода (high и low - по экстремумам, close - цена закрытия,
+         * к объему добавляется прирост объема бара младшего периода).
+         * Поэтому политика объема должна только прибавлять объем к бару.
+         * Остальные тики (новый бар, опоздавший тик) обрабатываются для каждого периода
+         *
+         * Вызывается из потока вебсокета или, если включена параллельная обработка,
+         * из потока пула, за которым закреплен символ
+         * \param tick Тик
+         */
+        void aggregate_tick(const common::StreamTick &tick) {
+            const uint64_t version = subscriptions_version.load(std::memory_order_acquire);
+
+            /* цену переводим в тип бара один раз на тик */
+            const uint32_t precision = symbol_registry.get_precision(tick.symbol_id);
+            price_type price;
+            common::set_candle_price(price, tick.price, precision);
+
+            std::lock_guard<std::mutex> lock(candles_mutex[tick.symbol_id]);
+            Cascade &cascade = cascades[tick.symbol_id];
+            if(cascade.version != version) build_cascade(tick.symbol_id, cascade, version);
+            if(cascade.cursors.empty()) return;
+
+            /* в ходе наблюдений было обнаружено,
+             * что 0-секунда считается прыдудщим баром, а не новым
+             * поэтому нужно вычесть 1 секунду из метки времени
+             */
+            const xtime::timestamp_t timestamp = tick.timestamp - 1;
+
+            /* в ходе наблюдений было обнаружено,
+             * что время бара взято как время окончания бара
+             * а не время начала
+             */
+            const uint32_t base_period = cascade.base_period;
+            const xtime::timestamp_t base_bar_timestamp = (timestamp - (timestamp % base_period)) + base_period;
+            const bool is_same_base = base_bar_timestamp == cascade.base_bar_timestamp;
+            cascade.base_bar_timestamp = base_bar_timestamp;
+
+            /* если бары закрывает таймер, изменения закрытых баров передаются как исправления */
+            const bool is_timer = is_bar_close_timer.load(std::memory_order_relaxed);
+
+            /* тик обновляет последний бар младшего периода, старшие периоды получают его изменения */
+            bool is_rolled = false;
+            CANDLE base_candle;
+            decltype(CANDLE::volume) volume_delta = 0;
+            const candle_data *base_candles = cascade.cursors[cascade.base_index].period_candles;
+            bool is_new_base = false;
+            if(is_same_base) {
+                if(base_candles && !base_candles->empty() &&
+                    base_candles->back().timestamp == base_bar_timestamp) {
+                    const CANDLE &last_candle = base_candles->back();
+                    base_candle = last_candle;
+                    base_candle.volume = 0;
+                    volume_policy.update(base_candle, last_candle, price, precision);
+                    volume_delta = base_candle.volume;
+                    base_candle.volume = last_candle.volume + volume_delta;
+                    base_candle.close = price;
+                    if(price > base_candle.high) base_candle.high = price;
+                    if(price < base_candle.low) base_candle.low = price;
+                    is_rolled = true;
+                }
+            } else {
+                is_new_base = !base_candles || base_candles->find(base_bar_timestamp) == candle_data::NONE;
+            }
+
+            period_data &symbol_candles = candles[tick.symbol_id];
+            bool is_new_candle = false;
+            for(CascadeCursor &cursor : cascade.cursors) {
+                const uint32_t p = cursor.period;
+                /* тик начинает бар младшего периода, который попадет во все периоды */
+                if(is_new_base) cursor.synced_timestamp = base_bar_timestamp;
+                if(!is_same_base || !cursor.is_multiple) {
+                    cursor.bar_timestamp = (timestamp - (timestamp % p)) + p;
+                }
+                const xtime::timestamp_t bar_timestamp = cursor.bar_timestamp;
+
+                /* бар периода уже последний, обновляем его */
+                candle_data *cursor_candles = cursor.period_candles;
+                if(cursor_candles && !cursor_candles->empty() &&
+                    cursor_candles->back().timestamp == bar_timestamp) {
+                    candle_data &period_candles = *cursor_candles;
+                    auto &candle = period_candles.back();
+                    if(is_rolled && cursor.is_multiple && cursor.synced_timestamp == base_bar_timestamp) {
+                        /* бар периода включает бар младшего периода */
+                        if(base_candle.high > candle.high) candle.high = base_candle.high;
+                        if(base_candle.low < candle.low) candle.low = base_candle.low;
+                        candle.close = base_candle.close;
+                        candle.volume += volume_delta;
+                    } else {
+                        volume_policy.update(candle, candle, price, precision);
+                        candle.close = price;
+                        if(price > candle.high) candle.high = price;
+                        if(price < candle.low) candle.low = price;
+                    }
+                    period_candles.mark_modified(period_candles.size() - 1);
+                    publish_cursor(tick.symbol_id, cursor, period_candles);
+                    if(is_timer && bar_timestamp <= cursor.closed_timestamp) emit_candle_correction(tick.symbol_id, candle, p);
+                    else emit_candle(tick.symbol_id, candle, p, false);
+                    continue;
+                }
+
+                /* ищем период */
+                if(!cursor_candles) {
+                    auto it_period = symbol_candles.find(p);
+                    if(it_period != symbol_candles.end()) {
+                        cursor_candles = &it_period->second;
+                        cursor.period_candles = cursor_candles;
+                    }
+                }
+                if(!cursor_candles) {
+                    /* период не найден, значит бара вообще нет. Инициализируем */
+                    CANDLE candle(price,price,price,price,bar_timestamp);
+                    volume_policy.init(candle);
+                    candle_data &period_candles = get_period_candles(symbol_candles, p);
+                    cursor.period_candles = &period_candles;
+                    store_candle(tick.symbol_id, period_candles, candle);
+                    publish_cursor(tick.symbol_id, cursor, period_candles);
+                    is_new_candle = true;
+                    emit_candle(tick.symbol_id, candle, p, false);
+                } else {
+                    /* период найдет, ищем бар */
+                    candle_data &period_candles = *cursor_candles;
+                    const size_t index = period_candles.find(bar_timestamp);
+                    if(index == candle_data::NONE && is_timer && bar_timestamp <= cursor.closed_timestamp) {
+                        /* опоздавший тик пропущенного бара, который уже закрыт */
+                        CANDLE candle(price,price,price,price,bar_timestamp);
+                        volume_policy.init(candle);
+                        store_candle(tick.symbol_id, period_candles, candle);
+                        publish_cursor(tick.symbol_id, cursor, period_candles);
+                        is_new_candle = true;
+                        emit_candle_correction(tick.symbol_id, candle, p);
+                    } else
+                    if(index == candle_data::NONE) {
+                        /* бар не найден */
+                        if(!period_candles.empty()) {
+                            /* если данные уже есть */
+                            /* получаем последний бар, вызываем функцию обратного вызова,
+                             * если таймер еще не закрыл его
+                             */
+                            const CANDLE &last_candle = period_candles.back();
+                            if(!is_timer || last_candle.timestamp > cursor.closed_timestamp) {
+                                emit_candle(tick.symbol_id, last_candle, p, true);
+                            }
+                            if(last_candle.timestamp > cursor.closed_timestamp) {
+                                cursor.closed_timestamp = last_candle.timestamp;
+                            }
+                        }
+                        /* добавляем бар */
+                        CANDLE candle(price,price,price,price,bar_timestamp);
+                        volume_policy.init(candle);
+                        store_candle(tick.symbol_id, period_candles, candle);
+                        publish_cursor(tick.symbol_id, cursor, period_candles);
+                        is_new_candle = true;
+                        emit_candle(tick.symbol_id, candle, p, false);
+                    } else {
+                        auto &candle = period_candles[index];
+                        volume_policy.update(candle, period_candles.back(), price, precision);
+                        candle.close = price;
+                        if(price > candle.high) candle.high = price;
+                        if(price < candle.low) candle.low = price;
+                        period_candles.mark_modified(index);
+                        publish_cursor(tick.symbol_id, cursor, period_candles);
+                        if(is_timer && bar_timestamp <= cursor.closed_timestamp) emit_candle_correction(tick.symbol_id, candle, p);
+                        else emit_candle(tick.symbol_id, candle, p, false);
+                    }
+                }
+            } // for
+
+            /* новый бар мог вытеснить бары в старший период */
+            if(is_new_candle) publish_candles(tick.symbol_id);
+        }
+
+        /** \brief Закрыть бары, время которых истекло
+         *
+         * Бар с меткой времени окончания T включает тики до T + 1 секунды,
+         * так как 0-секунда относится к предыдущему бару (см. aggregate_tick).
+         * Поэтому бар закрывается, когда время сервера достигает T + 1
+         * \param server_timestamp Метка времени сервера
+         * \return Метка времени сервера, когда истечет следующий бар, или 0, если открытых баров нет
+         */
+        xtime::ftimestamp_t close_expired_candles(const xtime::ftimestamp_t server_timestamp) {
+            xtime::ftimestamp_t next_timestamp = 0;
+            const uint32_t symbols_size = symbol_registry.size();
+            for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                {
+                    std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                    for(CascadeCursor &cursor : cascades[symbol_id].cursors) {
+                        if(!cursor.period_candles || cursor.period_candles->empty()) continue;
+                        const CANDLE &candle = cursor.period_candles->back();
+                        if(candle.timestamp <= cursor.closed_timestamp) continue;
+                        const xtime::ftimestamp_t close_timestamp = (xtime::ftimestamp_t)(candle.timestamp + 1);
+                        if(server_timestamp >= close_timestamp) {
+                            cursor.closed_timestamp = candle.timestamp;
+                            emit_candle(symbol_id, candle, cursor.period, true);
+                            continue;
+                        }
+                        if(next_timestamp == 0 || close_timestamp < next_timestamp) next_timestamp = close_timestamp;
+                    }
+                }
+                flush_dispatch(symbol_id);
+            }
+            return next_timestamp;
+        }
+
+        /** \brief Остановить поток закрытия баров
+         */
+        void stop_bar_close_timer() {
+            {
+                std::lock_guard<std::mutex> lock(bar_close_mutex);
+                is_bar_close_timer = false;
+            }
+            bar_close_condition.notify_all();
+            if(bar_close_future.valid()) bar_close_future.wait();
+        }
+
+        /** \brief Обработать все тики одного сообщения
+         * \param ticks Указатель на массив тиков
+         * \param ftimestamps Функция получения метки времени тика с дробной частью по индексу
+         * \param ticks_size Количество тиков
+         * \param receive_timestamp Метка времени компьютера в момент получения сообщения
+         */
+        template<class F>
+        void process_ticks(
+                const common::StreamTick *ticks,
+                F ftimestamps,
+                const size_t ticks_size,
+                const xtime::ftimestamp_t receive_timestamp) {
+            if(ticks_size == 0) return;
+            /* сначала весь пакет, затем каждый тик по отдельности */
+            emit_ticks(ticks, ticks_size, receive_timestamp);
+            for(size_t i = 0; i < ticks_size; ++i) {
+                process_tick(ticks[i], ftimestamps(i), receive_timestamp);
+            }
+            if(is_tick_journal) {
+                std::lock_guard<std::mutex> lock(tick_journal_mutex);
+                tick_journal.flush();
+            }
+        }
+
         /** \brief Парсер сообщения от вебсокета
-         * \param response Ответ от сервера
+         *
+         * Сообщения с тиками разбираются специализированным парсером без выделения памяти,
+         * остальные сообщения разбираются через nlohmann::json.
+         * Данные читаются прямо из буфера сообщения, без копирования в строку
+         * \param data Указатель на начало ответа от сервера
+         * \param length Длина ответа
+         * \param receive_timestamp Метка времени компьютера в момент получения сообщения
          */
-        void parser(const std::string &response) {
-            //std::cout << response << std::endl;
+        void parser(const char *data, const size_t length, const xtime::ftimestamp_t receive_timestamp) {
+            //std::cout << std::string(data, length) << std::endl;
             /* Пример сообщений
              * {"data":[{"field":"BTC/USD","action":"subscribe"}],"success":true,"errors":[]}
              * {"data":[{"assets":[{"rate":10800.91635,"precision":5,"repeat":0,"ask":10900.9164,"created_at":"2020-09-27T01:25:08.000000Z","bid":10700.9163,"ric":"BTC/USD"}],"action":"assets"}],"success":true,"errors":[]}
              * {"data":[{"assets":[{"rate":10800.90365,"precision":5,"repeat":0,"ask":10900.9037,"created_at":"2020-09-27T01:25:10.000000Z","bid":10700.9036,"ric":"BTC/USD"}],"action":"assets"}],"success":true,"errors":[]}
              */
+            const int err = assets_parser.parse(data, length);
+            if(err == common::OK) {
+                process_ticks(
+                    assets_parser.data(),
+                    [&](const size_t i) {return assets_parser.get_ftimestamp(i);},
+                    assets_parser.size(),
+                    receive_timestamp);
+                is_websocket_init = true;
+                return;
+            }
+            if(err != common::UNSUPPORTED_MESSAGE) {
+                std::cerr << "binomo api: BinomoApiPriceStream--->parser error, code = " << err << std::endl;
+                return;
+            }
+
             try {
-                json j = json::parse(response);
+                json j = json::parse(data, data + length);
+                json_ticks.clear();
+                json_ftimestamps.clear();
                 if(j["success"] == true) {
                     json j_data = j["data"];
                     for(size_t j = 0; j < j_data.size(); ++j) {
@@ -150,134 +1251,26 @@ namespace binomo_api {
                             tick.precision = j_element["precision"];
                             //j_element["ask"];
                             //j_element["bid"];
-                            tick.symbol = j_element["ric"];
-                            auto it_normalize_name = common::ric_to_normalize_name.find(tick.symbol);
-                            if(it_normalize_name == common::ric_to_normalize_name.end()) continue;
-                            tick.symbol = it_normalize_name->second;//common::normalize_symbol_name(tick.symbol);
+                            const std::string ric = j_element["ric"];
+                            /* символы регистрируются при подписке, тики остальных символов пропускаем */
+                            tick.symbol_id = symbol_registry.find_ric(ric.data(), ric.size());
+                            if(tick.symbol_id == SymbolRegistry::NONE) continue;
+                            tick.symbol = symbol_registry.get_name(tick.symbol_id);
 
                             std::string str_iso = j_element["created_at"];
-                            xtime::DateTime date_time;
-                            if(!xtime::convert_iso(str_iso, date_time)) continue;
-                            const double ftimestamp = date_time.get_ftimestamp();
-                            tick.timestamp = date_time.get_timestamp();
-
-                            /* проверяем, не поменялась ли метка времени */
-                            if(last_timestamp < ftimestamp) {
-
-                                /* если метка времени поменялась, найдем время сервера */
-                                xtime::ftimestamp_t pc_timestamp = xtime::get_ftimestamp();
-                                xtime::ftimestamp_t offset_timestamp = ftimestamp - pc_timestamp;
-                                update_offset_timestamp(offset_timestamp);
-                                last_timestamp = ftimestamp;
-
-                                /* запоминаем последнюю метку времени сервера */
-                                last_server_timestamp = ftimestamp;
-                            }
-
-                            /* обрабатываем функцию обратного вызова поступления тика */
-                            if(on_tick != nullptr) on_tick(tick);
-
-                            std::list<uint32_t> list_period;
-                            {
-                                std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
-                                auto it_list_symbol = list_subscriptions.find(tick.symbol);
-                                if(it_list_symbol == list_subscriptions.end()) {
-                                    continue;
-                                }
-                                list_period = it_list_symbol->second;
-                            }
-
-                            std::lock_guard<std::mutex> lock(candles_mutex);
-                            for(auto &p : list_period) {
-
-                                /* в ходе наблюдений было обнаружено,
-                                 * что 0-секунда считается прыдудщим баром, а не новым
-                                 * поэтому нужно вычесть 1 секунду из метки времени
-                                 */
-                                const xtime::timestamp_t timestamp = tick.timestamp - 1;
-
-                                /* в ходе наблюдений было обнаружено,
-                                 * что время бара взято как время окончания бара
-                                 * а не время начала
-                                 */
-                                const xtime::timestamp_t bar_timestamp = (timestamp - (timestamp % (p))) + p;
-
-                                auto it_symbol = candles.find(tick.symbol);
-                                if(it_symbol == candles.end()) {
-                                    /* если символ не найден, значит бара вообще нет. Инициализируем */
-                                    CANDLE candle(tick.price,tick.price,tick.price,tick.price, bar_timestamp);
-                                    if(volume_mode == MODE_VOLUME_ACC) {
-                                        candle.volume = 1;
-                                    } else
-                                    if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                        candle.volume = 0;
-                                    }
-                                    candles[tick.symbol][(p)][bar_timestamp] = candle;
-                                    if(on_candle != nullptr) on_candle(tick.symbol, candle, p,  false);
-                                } else {
-                                    /* символ найдет, ищем период */
-                                    auto it_period = it_symbol->second.find(p);
-                                    if(it_period == it_symbol->second.end()) {
-                                        /* период не найден, значит бара вообще нет. Инициализируем */
-                                        CANDLE candle(tick.price,tick.price,tick.price,tick.price,bar_timestamp);
-                                        if(volume_mode == MODE_VOLUME_ACC) {
-                                            candle.volume = 1;
-                                        } else
-                                        if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                            candle.volume = 0;
-                                        }
-                                        candles[tick.symbol][(p)][bar_timestamp] = candle;
-                                        if(on_candle != nullptr) on_candle(tick.symbol, candle, p, false);
-                                    } else {
-                                        /* период найдет, ищем бар */
-                                        auto it_last_candle = it_period->second.find(bar_timestamp);
-                                        if(it_last_candle == it_period->second.end()) {
-                                            /* бар не найден */
-                                            if(it_period->second.size() > 0) {
-                                                /* если данные уже есть */
-                                                auto it_candle = it_period->second.begin();
-                                                /* получаем последний бар, вызываем функцию обратного вызова */
-                                                std::advance(it_candle, it_period->second.size() - 1);
-                                                if(on_candle != nullptr) on_candle(tick.symbol, it_candle->second, p, true);
-                                            }
-                                            /* добавляем бар */
-                                            CANDLE candle(tick.price,tick.price,tick.price,tick.price,bar_timestamp);
-                                            if(volume_mode == MODE_VOLUME_ACC) {
-                                                candle.volume = 1;
-                                            } else
-                                            if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                                candle.volume = 0;
-                                            }
-                                            candles[tick.symbol][p][bar_timestamp] = candle;
-                                            if(on_candle != nullptr) on_candle(tick.symbol, candle, p, false);
-                                        } else {
-                                            auto &candle = it_last_candle->second;
-                                            if(volume_mode == MODE_VOLUME_ACC) {
-                                                candle.volume += 1.0d;
-                                            } else
-                                            if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                                if(candle.volume == 0) {
-                                                    auto it_candle = it_period->second.begin();
-                                                    /* получаем последний бар, вызываем функцию обратного вызова */
-                                                    std::advance(it_candle, it_period->second.size() - 1);
-                                                    const double diff = std::abs(tick.price - it_candle->second.close);
-                                                    candle.volume += (std::pow(10.0d, tick.precision) * diff + 0.5d);
-                                                } else {
-                                                    const double diff = std::abs(tick.price - candle.close);
-                                                    candle.volume += (std::pow(10.0d, tick.precision) * diff + 0.5d);
-                                                }
-                                            }
-                                            candle.close = tick.price;
-                                            if(tick.price > candle.high) candle.high = tick.price;
-                                            if(tick.price < candle.low) candle.low = tick.price;
-                                            if(on_candle != nullptr) on_candle(tick.symbol, candle, p, false);
-                                        }
-                                    }
-                                }
-                            } // for
+                            xtime::ftimestamp_t ftimestamp = 0;
+                            if(!iso_decoder.decode(str_iso, ftimestamp)) continue;
+                            tick.timestamp = (xtime::timestamp_t)ftimestamp;
+                            json_ticks.push_back(tick);
+                            json_ftimestamps.push_back(ftimestamp);
                         } // for i
                     } // for j
                 }
+                process_ticks(
+                    json_ticks.data(),
+                    [&](const size_t i) {return json_ftimestamps[i];},
+                    json_ticks.size(),
+                    receive_timestamp);
                 is_websocket_init = true;
             }
             catch(const json::parse_error& e) {
@@ -305,13 +1298,46 @@ namespace binomo_api {
             const uint32_t period,
             const bool close_candle)> on_candle = nullptr;
 
+        /** \brief Функция обратного вызова бара с идентификатором символа
+         *
+         * Имя символа можно получить через get_symbol_name()
+         */
+        std::function<void(
+            const uint32_t symbol_id,
+            const CANDLE &candle,
+            const uint32_t period,
+            const bool close_candle)> on_candle_id = nullptr;
+
+        /** \brief Функция обратного вызова исправления закрытого бара
+         *
+         * Вызывается, когда включено закрытие баров по таймеру (см. set_bar_close_timer)
+         * и после закрытия бара пришел опоздавший тик этого бара.
+         * Бар передается целиком, с учетом опоздавшего тика
+         */
+        std::function<void(
+            const uint32_t symbol_id,
+            const CANDLE &candle,
+            const uint32_t period)> on_candle_correction = nullptr;
+
         std::function<void(const common::StreamTick &tick)> on_tick = nullptr;
+
+        /** \brief Функция обратного вызова пакета тиков
+         *
+         * Вызывается один раз на сообщение вебсокета со всеми тиками этого сообщения,
+         * до вызовов on_tick. Массив тиков действителен только во время вызова.
+         * Параметр receive_timestamp - метка времени компьютера в момент получения сообщения
+         */
+        std::function<void(
+            const common::StreamTick *ticks,
+            const size_t ticks_size,
+            const xtime::ftimestamp_t receive_timestamp)> on_ticks = nullptr;
         std::function<void()> on_start = nullptr;
 
         /** \brief Конструктор класса для получения потока котировок
          * \param user_sert_file Файл-сертификат. По умолчанию используется от curl: curl-ca-bundle.crt
          */
-        BinomoApiPriceStream(const std::string user_sert_file = "curl-ca-bundle.crt") {
+        BinomoApiPriceStream(const std::string user_sert_file = "curl-ca-bundle.crt") :
+                assets_parser(symbol_registry) {
             sert_file = user_sert_file;
             offset_timestamp = 0;
             is_websocket_init = false;
@@ -339,6 +1365,10 @@ namespace binomo_api {
                     std::cerr << "binomo api: ~BinomoApiPriceStream() error" << std::endl;
                 }
             }
+            stop_bar_close_timer();
+            aggregation_pool.stop();
+            dispatch_queue.stop();
+            callback_executor.stop();
         };
 
         /** \brief Состояние соединения
@@ -376,57 +1406,241 @@ namespace binomo_api {
             return xtime::get_ftimestamp() + offset_timestamp;
         }
 
-        /** \brief Получить последнюю метку времени сервера
+        /** \brief Получить последнюю метку времени сервера
+         *
+         * Данный метод возвращает последнюю полученную метку времени сервера. Часовая зона: UTC/GMT
+         * \return Метка времени сервера
+         */
+        inline xtime::ftimestamp_t get_last_server_timestamp() {
+            return last_server_timestamp;
+        }
+
+        /** \brief Получить смещение метки времени ПК
+         * \return Смещение метки времени ПК
+         */
+        inline xtime::ftimestamp_t get_offset_timestamp() {
+            return offset_timestamp;
+        }
+
+        /** \brief Получить идентификатор символа
+         *
+         * Идентификатор назначается символу при подписке
+         * \param symbol Имя символа
+         * \return Идентификатор символа или SymbolRegistry::NONE
+         */
+        inline uint32_t get_symbol_id(const std::string &symbol) {
+            return symbol_registry.get_id(symbol);
+        }
+
+        /** \brief Получить имя символа
+         * \param symbol_id Идентификатор символа
+         * \return Нормализованное имя символа
+         */
+        inline const std::string &get_symbol_name(const uint32_t symbol_id) {
+            return symbol_registry.get_name(symbol_id);
+        }
+
+        /** \brief Получить реестр символов потока
+         */
+        inline const SymbolRegistry &get_symbol_registry() {
+            return symbol_registry;
+        }
+
+        /** \brief Получить цену тика символа
+         *
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \return Последняя цена bid
+         */
+        inline double get_price(const uint32_t symbol_id, const uint32_t period) {
+            if(!is_websocket_init) return 0.0;
+            if(!symbol_registry.check_id(symbol_id)) return 0.0;
+            const PublishedPeriod *slot = find_published_candle(symbol_id, period);
+            if(slot) {
+                const PublishedCandle value = slot->value.load();
+                if(value.num_candles == 0) return 0.0;
+                return common::get_candle_price(value.candle.close, symbol_registry.get_precision(symbol_id));
+            }
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return 0.0;
+            if(it_period->second.empty()) return 0.0;
+            return common::get_candle_price(
+                it_period->second.back().close,
+                symbol_registry.get_precision(symbol_id));
+        }
+
+        /** \brief Получить цену тика символа
+         *
+         * \param symbol Имя символа
+         * \param period Период
+         * \return Последняя цена bid
+         */
+        inline double get_price(const std::string &symbol, const uint32_t period) {
+            return get_price(symbol_registry.get_id(symbol), period);
+        }
+
+        /** \brief Получить цену тика символа
+         * \param symbol_id Идентификатор символа
+         * \return Последняя цена bid
+         */
+        inline double get_price(const uint32_t symbol_id) {
+            if(!is_websocket_init) return 0.0;
+            if(!symbol_registry.check_id(symbol_id)) return 0.0;
+            if(published_ticks[symbol_id].published()) return published_ticks[symbol_id].load().price;
+            /* тиков еще не было, берем цену из баров */
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            if(symbol_candles.empty()) return 0.0;
+            auto it_period = symbol_candles.begin();
+            if(it_period->second.empty()) return 0.0;
+            return common::get_candle_price(
+                it_period->second.back().close,
+                symbol_registry.get_precision(symbol_id));
+        }
+
+        /** \brief Получить цену тика символа
+         * \param symbol Имя символа
+         * \return Последняя цена bid
+         */
+        inline double get_price(const std::string &symbol) {
+            return get_price(symbol_registry.get_id(symbol));
+        }
+
+        /** \brief Получить последнее состояние всех потоков котировок
+         *
+         * Для каждого символа и каждого периода баров записывается цена,
+         * время последнего тика и последний бар. Метод не использует блокировки,
+         * состояние каждого потока читается согласованно.
+         * Память массива переиспользуется между вызовами
+         * \param output Массив состояний потоков
+         * \return Количество потоков
+         */
+        size_t get_latest_all(std::vector<common::StreamQuote<CANDLE>> &output) {
+            output.clear();
+            if(!is_websocket_init) return 0;
+            const uint32_t symbols_size = symbol_registry.size();
+            for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                const bool is_tick = published_ticks[symbol_id].published();
+                PublishedTick tick;
+                if(is_tick) tick = published_ticks[symbol_id].load();
+                const uint32_t precision = symbol_registry.get_precision(symbol_id);
+                for(const PublishedPeriod &slot : published_candles[symbol_id]) {
+                    const uint32_t period = slot.period.load(std::memory_order_acquire);
+                    if(period == 0) break;
+                    const PublishedCandle value = slot.value.load();
+                    output.emplace_back();
+                    common::StreamQuote<CANDLE> &quote = output.back();
+                    quote.symbol_id = symbol_id;
+                    quote.period = period;
+                    quote.num_candles = value.num_candles;
+                    if(value.num_candles != 0) quote.candle = value.candle;
+                    if(is_tick) {
+                        quote.price = tick.price;
+                        quote.timestamp = tick.timestamp;
+                    } else
+                    if(value.num_candles != 0) {
+                        quote.price = common::get_candle_price(value.candle.close, precision);
+                    }
+                }
+            }
+            return output.size();
+        }
+
+        /** \brief Получить последнее состояние потоков котировок нескольких символов
          *
-         * Данный метод возвращает последнюю полученную метку времени сервера. Часовая зона: UTC/GMT
-         * \return Метка времени сервера
+         * Метод не использует блокировки, если период опубликован
+         * \param symbol_ids Массив идентификаторов символов
+         * \param size Количество символов
+         * \param period Период
+         * \param output Массив не меньше size состояний, порядок совпадает с symbol_ids
+         * \return Количество записанных состояний
          */
-        inline xtime::ftimestamp_t get_last_server_timestamp() {
-            return last_server_timestamp;
+        size_t get_prices(
+                const uint32_t *symbol_ids,
+                const size_t size,
+                const uint32_t period,
+                common::StreamQuote<CANDLE> *output) {
+            for(size_t i = 0; i < size; ++i) {
+                const uint32_t symbol_id = symbol_ids[i];
+                common::StreamQuote<CANDLE> &quote = output[i];
+                quote = common::StreamQuote<CANDLE>();
+                quote.symbol_id = symbol_id;
+                quote.period = period;
+                if(!is_websocket_init) continue;
+                if(!symbol_registry.check_id(symbol_id)) continue;
+                const PublishedPeriod *slot = find_published_candle(symbol_id, period);
+                if(slot) {
+                    const PublishedCandle value = slot->value.load();
+                    quote.num_candles = value.num_candles;
+                    if(value.num_candles != 0) quote.candle = value.candle;
+                } else {
+                    std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                    const period_data &symbol_candles = candles[symbol_id];
+                    auto it_period = symbol_candles.find(period);
+                    if(it_period != symbol_candles.end() && !it_period->second.empty()) {
+                        quote.num_candles = get_stored_size(find_period_archive(symbol_id, period), it_period->second);
+                        quote.candle = it_period->second.back();
+                    }
+                }
+                if(published_ticks[symbol_id].published()) {
+                    const PublishedTick tick = published_ticks[symbol_id].load();
+                    quote.price = tick.price;
+                    quote.timestamp = tick.timestamp;
+                } else
+                if(quote.num_candles != 0) {
+                    quote.price = common::get_candle_price(quote.candle.close, symbol_registry.get_precision(symbol_id));
+                }
+            }
+            return size;
         }
 
-        /** \brief Получить смещение метки времени ПК
-         * \return Смещение метки времени ПК
+        /** \brief Получить последнее состояние потоков котировок нескольких символов
+         * \param symbol_ids Идентификаторы символов
+         * \param period Период
+         * \param output Массив состояний, порядок совпадает с symbol_ids
+         * \return Количество записанных состояний
          */
-        inline xtime::ftimestamp_t get_offset_timestamp() {
-            return offset_timestamp;
+        inline size_t get_prices(
+                const std::vector<uint32_t> &symbol_ids,
+                const uint32_t period,
+                std::vector<common::StreamQuote<CANDLE>> &output) {
+            output.resize(symbol_ids.size());
+            return get_prices(symbol_ids.data(), symbol_ids.size(), period, output.data());
         }
 
-        /** \brief Получить цену тика символа
+        /** \brief Получить бар
          *
-         * \param symbol Имя символа
+         * \param symbol_id Идентификатор символа
          * \param period Период
-         * \return Последняя цена bid
-         */
-        inline double get_price(const std::string &symbol, const uint32_t period) {
-            if(!is_websocket_init) return 0.0;
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return 0.0;
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return 0.0;
-            const size_t size_candle = it_period->second.size();
-            if(size_candle == 0) return 0.0;
-            auto it_begin_candle = it_period->second.begin();
-            std::advance(it_begin_candle, (size_candle - 1));
-            return it_begin_candle->second.close;
-        }
-
-        /** \brief Получить цену тика символа
-         * \param symbol Имя символа
-         * \return Последняя цена bid
+         * \param offset Смещение
+         * \return Бар
          */
-        inline double get_price(const std::string &symbol) {
-            if(!is_websocket_init) return 0.0;
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return 0.0;
-            if(it_symbol->second.size() == 0) return 0.0;
-            auto it_period = it_symbol->second.begin();
-            auto it_begin_candle = it_period->second.begin();
-            return it_begin_candle->second.close;
+        inline CANDLE get_candle(
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const size_t offset = 0) {
+            if(!is_websocket_init) return CANDLE();
+            if(!symbol_registry.check_id(symbol_id)) return CANDLE();
+            if(offset == 0) {
+                const PublishedPeriod *slot = find_published_candle(symbol_id, period);
+                if(slot) {
+                    const PublishedCandle value = slot->value.load();
+                    if(value.num_candles == 0) return CANDLE();
+                    return value.candle;
+                }
+            }
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return CANDLE();
+            if(offset < it_period->second.size()) return it_period->second.from_back(offset);
+            /* старые бары могут быть в сжатом хранилище */
+            const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, period);
+            const size_t stored_size = get_stored_size(archive, it_period->second);
+            if(offset >= stored_size) return CANDLE();
+            return get_stored_candle(archive, it_period->second, stored_size - 1 - offset);
         }
 
         /** \brief Получить бар
@@ -440,19 +1654,26 @@ namespace binomo_api {
                 const std::string &symbol,
                 const uint32_t period,
                 const size_t offset = 0) {
-            if(!is_websocket_init) return CANDLE();
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return CANDLE();
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return CANDLE();
-            const size_t size_candle = it_period->second.size();
-            if(size_candle == 0) return CANDLE();
-            if(offset >= size_candle) return CANDLE();
-            auto it_begin_candle = it_period->second.begin();
-            std::advance(it_begin_candle, (size_candle - 1 - offset));
-            return it_begin_candle->second;
+            return get_candle(symbol_registry.get_id(symbol), period, offset);
+        }
+
+        /** \brief Получить количество баров
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \return Количество баров
+         */
+        inline uint32_t get_num_candles(
+                const uint32_t symbol_id,
+                const uint32_t period) {
+            if(!is_websocket_init) return 0;
+            if(!symbol_registry.check_id(symbol_id)) return 0;
+            const PublishedPeriod *slot = find_published_candle(symbol_id, period);
+            if(slot) return slot->value.load().num_candles;
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return 0;
+            return get_stored_size(find_period_archive(symbol_id, period), it_period->second);
         }
 
         /** \brief Получить количество баров
@@ -463,14 +1684,32 @@ namespace binomo_api {
         inline uint32_t get_num_candles(
                 const std::string &symbol,
                 const uint32_t period) {
-            if(!is_websocket_init) return 0;
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return 0;
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return 0;
-            return it_period->second.size();
+            return get_num_candles(symbol_registry.get_id(symbol), period);
+        }
+
+        /** \brief Получить бар по метке времени
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \param timestamp Метка времени
+         * \return Бар
+         */
+        inline CANDLE get_timestamp_candle(
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const xtime::timestamp_t timestamp) {
+            if(!is_websocket_init) return CANDLE();
+            if(!symbol_registry.check_id(symbol_id)) return CANDLE();
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return CANDLE();
+            const size_t index = it_period->second.find(timestamp);
+            if(index != candle_data::NONE) return it_period->second[index];
+            const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, period);
+            if(!archive) return CANDLE();
+            const size_t archive_index = archive->find(timestamp);
+            if(archive_index == CandleArchive<CANDLE>::NONE) return CANDLE();
+            return archive->get(archive_index);
         }
 
         /** \brief Получить бар по метке времени
@@ -483,17 +1722,198 @@ namespace binomo_api {
                 const std::string &symbol,
                 const uint32_t period,
                 const xtime::timestamp_t timestamp) {
-            if(!is_websocket_init) return CANDLE();
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return CANDLE();
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return CANDLE();
-            if(it_period->second.size() == 0) return CANDLE();
-            auto it_candle = it_period->second.find(timestamp);
-            if(it_candle == it_period->second.end()) return CANDLE();
-            return it_candle->second;
+            return get_timestamp_candle(symbol_registry.get_id(symbol), period, timestamp);
+        }
+
+        /** \brief Получить бары начиная с метки времени
+         *
+         * Весь диапазон копируется за одну блокировку баров символа
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \param from_timestamp Метка времени первого бара. Если такого бара нет, диапазон начнется со следующего бара
+         * \param count Максимальное количество баров
+         * \param output Массив не меньше count баров, бары записываются от старых к новым
+         * \return Количество скопированных баров
+         */
+        size_t get_candles(
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const xtime::timestamp_t from_timestamp,
+                const size_t count,
+                CANDLE *output) {
+            if(!is_websocket_init) return 0;
+            if(!symbol_registry.check_id(symbol_id)) return 0;
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return 0;
+            const candle_data &period_candles = it_period->second;
+            const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, period);
+            return copy_stored_candles(
+                archive, period_candles,
+                get_stored_lower_bound(archive, period_candles, from_timestamp),
+                count, output);
+        }
+
+        /** \brief Получить бары начиная с метки времени
+         * \param symbol Имя символа
+         * \param period Период
+         * \param from_timestamp Метка времени первого бара
+         * \param count Максимальное количество баров
+         * \param output Массив не меньше count баров
+         * \return Количество скопированных баров
+         */
+        inline size_t get_candles(
+                const std::string &symbol,
+                const uint32_t period,
+                const xtime::timestamp_t from_timestamp,
+                const size_t count,
+                CANDLE *output) {
+            return get_candles(symbol_registry.get_id(symbol), period, from_timestamp, count, output);
+        }
+
+        /** \brief Получить последние бары
+         *
+         * Копирует count баров, последний из которых имеет смещение offset,
+         * за одну блокировку баров символа. Если баров меньше, копируются все доступные
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \param offset Смещение последнего бара диапазона, 0 - последний бар
+         * \param count Максимальное количество баров
+         * \param output Массив не меньше count баров, бары записываются от старых к новым
+         * \return Количество скопированных баров
+         */
+        size_t get_last_candles(
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const size_t offset,
+                const size_t count,
+                CANDLE *output) {
+            if(!is_websocket_init) return 0;
+            if(!symbol_registry.check_id(symbol_id)) return 0;
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return 0;
+            const candle_data &period_candles = it_period->second;
+            const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, period);
+            const size_t stored_size = get_stored_size(archive, period_candles);
+            if(offset >= stored_size) return 0;
+            const size_t end = stored_size - offset;
+            const size_t begin = end > count ? end - count : 0;
+            return copy_stored_candles(archive, period_candles, begin, end - begin, output);
+        }
+
+        /** \brief Получить последние бары
+         * \param symbol Имя символа
+         * \param period Период
+         * \param offset Смещение последнего бара диапазона, 0 - последний бар
+         * \param count Максимальное количество баров
+         * \param output Массив не меньше count баров
+         * \return Количество скопированных баров
+         */
+        inline size_t get_last_candles(
+                const std::string &symbol,
+                const uint32_t period,
+                const size_t offset,
+                const size_t count,
+                CANDLE *output) {
+            return get_last_candles(symbol_registry.get_id(symbol), period, offset, count, output);
+        }
+
+        /** \brief Получить матрицу баров нескольких символов, выровненную по времени
+         *
+         * Бары каждого символа копируются за одну блокировку баров символа.
+         * Пропущенные бары отмечаются в матрице и заполняются в зависимости от fill_mode
+         * \param symbol_ids Идентификаторы символов, по одному на столбец
+         * \param period Период
+         * \param from_timestamp Метка времени первого бара, округляется вниз до периода
+         * \param count Количество баров (строк матрицы)
+         * \param matrix Матрица баров, память переиспользуется между вызовами
+         * \param fill_mode Заполнение пропущенных баров, CandleMatrix<CANDLE>::FILL_NONE или FILL_FORWARD
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int get_candle_matrix(
+                const std::vector<uint32_t> &symbol_ids,
+                const uint32_t period,
+                const xtime::timestamp_t from_timestamp,
+                const size_t count,
+                CandleMatrix<CANDLE> &matrix,
+                const int fill_mode = CandleMatrix<CANDLE>::FILL_FORWARD) {
+            if(period == 0) return common::INVALID_PARAMETER;
+            const xtime::timestamp_t first_timestamp = from_timestamp - (from_timestamp % period);
+            matrix.reset(symbol_ids, period, first_timestamp, count);
+            if(!is_websocket_init) return common::NO_PRICE_STREAM_SUBSCRIPTION;
+            for(size_t column = 0; column < symbol_ids.size(); ++column) {
+                const uint32_t symbol_id = symbol_ids[column];
+                if(!symbol_registry.check_id(symbol_id)) continue;
+                std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                const period_data &symbol_candles = candles[symbol_id];
+                auto it_period = symbol_candles.find(period);
+                if(it_period == symbol_candles.end()) continue;
+                const candle_data &period_candles = it_period->second;
+                const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, period);
+                const size_t stored_size = get_stored_size(archive, period_candles);
+                size_t index = get_stored_lower_bound(archive, period_candles, first_timestamp);
+                /* цена закрытия для заполнения, до окна берем предыдущий бар */
+                bool is_fill_price = false;
+                price_type fill_price = price_type();
+                if(index > 0) {
+                    fill_price = get_stored_candle(archive, period_candles, index - 1).close;
+                    is_fill_price = true;
+                }
+                CANDLE candle;
+                if(index < stored_size) candle = get_stored_candle(archive, period_candles, index);
+                for(size_t row = 0; row < count; ++row) {
+                    const xtime::timestamp_t timestamp = first_timestamp + (xtime::timestamp_t)row * period;
+                    while(index < stored_size && candle.timestamp < timestamp) {
+                        if(++index < stored_size) candle = get_stored_candle(archive, period_candles, index);
+                    }
+                    if(index < stored_size && candle.timestamp == timestamp) {
+                        matrix.set(row, column, candle, true);
+                        fill_price = candle.close;
+                        is_fill_price = true;
+                        if(++index < stored_size) candle = get_stored_candle(archive, period_candles, index);
+                    } else
+                    if(fill_mode == CandleMatrix<CANDLE>::FILL_FORWARD && is_fill_price) {
+                        matrix.set_fill(row, column, fill_price);
+                    }
+                }
+            }
+            return common::OK;
+        }
+
+        /** \brief Получить снимок истории баров
+         *
+         * Снимок не изменяется и не блокирует поток котировок, его можно читать
+         * из любого потока сколько угодно долго. Получение снимка копирует
+         * только бары, добавленные или измененные с прошлого снимка.
+         * Память снимка освобождается, когда его перестает использовать последний читатель
+         * \param symbol_id Идентификатор символа
+         * \param period Период
+         * \return Снимок истории баров или nullptr, если баров периода нет
+         */
+        std::shared_ptr<const CandleView<CANDLE>> get_candles_view(
+                const uint32_t symbol_id,
+                const uint32_t period) {
+            if(!is_websocket_init) return nullptr;
+            if(!symbol_registry.check_id(symbol_id)) return nullptr;
+            std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+            const period_data &symbol_candles = candles[symbol_id];
+            auto it_period = symbol_candles.find(period);
+            if(it_period == symbol_candles.end()) return nullptr;
+            return candle_views[symbol_id][period].sync(it_period->second);
+        }
+
+        /** \brief Получить снимок истории баров
+         * \param symbol Имя символа
+         * \param period Период
+         * \return Снимок истории баров или nullptr, если баров периода нет
+         */
+        inline std::shared_ptr<const CandleView<CANDLE>> get_candles_view(
+                const std::string &symbol,
+                const uint32_t period) {
+            return get_candles_view(symbol_registry.get_id(symbol), period);
         }
 
         /** \brief Инициализировать массив японских свечей
@@ -507,26 +1927,71 @@ namespace binomo_api {
                 const std::string &symbol,
                 const uint32_t period,
                 const T &new_candles) {
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) {
-                candles.insert(
-                    std::pair<std::string, period_data>(s, period_data()));
-                it_symbol = candles.find(s);
-            }
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) {
-                it_symbol->second.insert(
-                    std::pair<uint32_t, candle_data>(period, candle_data()));
-                it_period = it_symbol->second.find(period);
+            uint32_t symbol_id = SymbolRegistry::NONE;
+            const int err = symbol_registry.add(symbol, symbol_id);
+            if(err != common::OK) return err;
+            {
+                std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                period_data &symbol_candles = candles[symbol_id];
+                candle_data &period_candles = get_period_candles(symbol_candles, period);
+                const size_t size = period_candles.size();
+                period_candles.merge(new_candles);
+                total_candles += period_candles.size() - size;
+                /* бары не старше сжатых уже лежат в сжатом хранилище */
+                const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, period);
+                if(archive) {
+                    while(!period_candles.empty() && period_candles.front().timestamp <= archive->get_last_timestamp()) {
+                        period_candles.pop_front();
+                        --total_candles;
+                    }
+                }
+                enforce_retention(symbol_id, period_candles);
+                publish_candles(symbol_id);
+                /* бары истории могли заменить последние бары, план строится заново */
+                cascades[symbol_id].version = 0;
             }
+            enforce_memory_budget();
+            return common::OK;
+        }
 
-            for(auto &candle : new_candles) {
-                it_period->second.insert(
-                    std::pair<xtime::timestamp_t, CANDLE>(candle.timestamp, candle));
+        /** \brief Включить закрытие баров по времени сервера
+         *
+         * Без таймера бар закрывается (on_candle с close_candle = true) только
+         * с приходом первого тика следующего бара, что на редко торгуемых символах
+         * может случиться через несколько секунд. Таймер закрывает последний бар
+         * каждого периода каждого символа, как только время сервера
+         * (время компьютера со смещением, см. get_server_timestamp) выходит за границу бара.
+         * Если после этого придет опоздавший тик закрытого бара,
+         * бар будет обновлен и передан в on_candle_correction.
+         * Функции обратного вызова баров вызываются из потока таймера
+         * после снятия блокировки баров символа
+         * \param value Включить или выключить таймер
+         */
+        void set_bar_close_timer(const bool value) {
+            if(!value) {
+                stop_bar_close_timer();
+                return;
             }
-            return common::OK;
+            if(is_bar_close_timer) return;
+            if(bar_close_future.valid()) bar_close_future.wait();
+            is_bar_close_timer = true;
+            bar_close_future = std::async(std::launch::async, [&]() {
+                /* смещение времени сервера может меняться, поэтому спим не дольше MAX_DELAY */
+                const xtime::ftimestamp_t MAX_DELAY = 0.1;
+                std::unique_lock<std::mutex> lock(bar_close_mutex);
+                while(is_bar_close_timer) {
+                    lock.unlock();
+                    const xtime::ftimestamp_t server_timestamp = get_server_timestamp();
+                    const xtime::ftimestamp_t next_timestamp = close_expired_candles(server_timestamp);
+                    xtime::ftimestamp_t delay = MAX_DELAY;
+                    if(next_timestamp != 0 && next_timestamp - server_timestamp < delay) {
+                        delay = next_timestamp - server_timestamp;
+                    }
+                    lock.lock();
+                    if(!is_bar_close_timer) break;
+                    bar_close_condition.wait_for(lock, std::chrono::duration<double>(delay));
+                }
+            });
         }
 
         /** \brief Ждать закрытие бара (минутного)
@@ -582,6 +2047,12 @@ namespace binomo_api {
                 std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
                 return;
             }
+            uint32_t symbol_id = SymbolRegistry::NONE;
+            const int err = symbol_registry.add(s, symbol_id);
+            if(err != common::OK) {
+                print_symbol_error(s, err);
+                return;
+            }
             json j;
             j["action"] = "subscribe";
             j["rics"] = json::array();
@@ -624,6 +2095,12 @@ namespace binomo_api {
 					std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
                     continue;
 				}
+                uint32_t symbol_id = SymbolRegistry::NONE;
+                const int err = symbol_registry.add(s, symbol_id);
+                if(err != common::OK) {
+                    print_symbol_error(s, err);
+                    continue;
+                }
                 j["rics"][i] = it_ric->second;
             }
             send(j.dump());
@@ -651,25 +2128,445 @@ namespace binomo_api {
         }
 
         /** \brief Подписаться на котировки
+         *
+         * Поток котировок поддерживает не более SymbolRegistry::MAX_SYMBOLS (64) символов
+         * за все время жизни, включая символы из снимка и init_array_candles.
+         * Символы сверх этого количества не добавляются, об этом выводится сообщение
          * \param symbol_list Список имен символов/валютных пар с периодом
          * \return Вернет true, если подключение есть и сообщения были переданы
          */
         bool add_candles_stream(const std::vector<std::pair<std::string, uint32_t>> &symbol_list) {
             std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
             for(auto &symbol : symbol_list) {
-                std::string s = binomo_api::common::normalize_symbol_name(symbol.first);
-				auto it_ric = binomo_api::common::normalize_name_to_ric.find(s);
-				if(it_ric == binomo_api::common::normalize_name_to_ric.end()) {
-					std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
+                uint32_t symbol_id = SymbolRegistry::NONE;
+                const int err = symbol_registry.add(symbol.first, symbol_id);
+				if(err != common::OK) {
+					print_symbol_error(symbol.first, err);
                     continue;
 				}
-                list_subscriptions[symbol.first].push_back(symbol.second);
+                std::vector<uint32_t> &periods = list_subscriptions[symbol_id];
+                if(std::find(periods.begin(), periods.end(), symbol.second) != periods.end()) continue;
+                periods.push_back(symbol.second);
             }
+            ++subscriptions_version;
             return true;
         }
 
+        /** \brief Установить режим объема
+         *
+         * Доступно только для политики VolumeRuntimePolicy
+         * \param value Режим объема (0 - отключено, 1 - подсчет тиков, 2 - взвешенный подсчет тиков)
+         */
         void set_volume_mode(const int value) {
-            volume_mode = value;
+            volume_policy.set_mode(value);
+        }
+
+        /** \brief Задать ограничение хранения баров периода
+         *
+         * Когда количество баров достигает max_candles, самый старый бар вытесняется за O(1).
+         * Если задан tier_period, вытесненные бары сворачиваются в бары этого периода,
+         * например минутные бары старше N дней превращаются в часовые.
+         * Если включено сжатие, вытесненные бары сохраняются в сжатом хранилище
+         * и остаются доступны через get_candle, get_timestamp_candle, get_candles и т.д.,
+         * а последние max_candles баров хранятся без сжатия.
+         * Ограничение применяется и к уже сохраненным барам
+         * \param period Период
+         * \param max_candles Максимальное количество баров, 0 - без ограничений
+         * \param tier_period Старший период для свернутых баров, 0 - не сворачивать
+         * \param is_compressed Сжимать вытесненные бары
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int set_retention(
+                const uint32_t period,
+                const size_t max_candles,
+                const uint32_t tier_period = 0,
+                const bool is_compressed = false) {
+            if(period == 0) return common::INVALID_PARAMETER;
+            if(tier_period != 0 && (tier_period <= period || (tier_period % period) != 0)) {
+                return common::INVALID_PARAMETER;
+            }
+            {
+                std::lock_guard<std::mutex> lock(retention_mutex);
+                Retention &period_retention = retention[period];
+                period_retention.max_candles = max_candles;
+                period_retention.tier_period = tier_period;
+                period_retention.is_compressed = is_compressed;
+            }
+            const uint32_t symbols_size = symbol_registry.size();
+            for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                period_data &symbol_candles = candles[symbol_id];
+                auto it_period = symbol_candles.find(period);
+                if(it_period == symbol_candles.end()) continue;
+                it_period->second.set_max_size(max_candles);
+                it_period->second.set_tier_period(tier_period);
+                it_period->second.set_compressed(is_compressed);
+                reserve_period_candles(it_period->second);
+                enforce_retention(symbol_id, it_period->second);
+                publish_candles(symbol_id);
+            }
+            enforce_memory_budget();
+            return common::OK;
+        }
+
+        /** \brief Задать общее ограничение памяти под бары
+         *
+         * Учитывается размер всех хранимых баров всех символов и периодов.
+         * При превышении вытесняются самые старые бары среди всех буферов,
+         * в каждом буфере остается хотя бы последний бар. Буферы старших периодов,
+         * в которые сворачиваются вытесненные бары, затрагиваются в последнюю очередь.
+         * Если для периода включено сжатие, вытесненные бары переходят
+         * в сжатое хранилище, которое в ограничении не учитывается
+         * \param bytes Ограничение в байтах, 0 - без ограничений
+         */
+        inline void set_memory_budget(const size_t bytes) {
+            memory_budget = bytes;
+            enforce_memory_budget();
+        }
+
+        /** \brief Получить объем памяти, занятый хранимыми барами
+         * \return Размер всех хранимых баров в байтах
+         */
+        inline size_t get_memory_usage() const {
+            return total_candles * sizeof(CANDLE);
+        }
+
+        /** \brief Получить объем памяти, выделенный под буферы баров и сжатые бары
+         * \return Размер всех буферов баров и сжатых хранилищ в байтах, не меньше get_memory_usage()
+         */
+        size_t get_memory_allocated() {
+            size_t bytes = 0;
+            const uint32_t symbols_size = symbol_registry.size();
+            for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                for(auto &item : candles[symbol_id]) {
+                    bytes += item.second.get_memory_usage();
+                }
+                for(auto &item : archives[symbol_id]) {
+                    bytes += item.second.get_memory_usage();
+                }
+            }
+            return bytes;
+        }
+
+        /** \brief Сохранить снимок хранилища баров
+         *
+         * В снимок попадают все бары всех символов и периодов, включая сжатые.
+         * Под блокировкой журнала тиков бары только копируются, а журнал переходит
+         * в новый файл. Запись снимка идет без блокировок, старые файлы журнала
+         * удаляются после того, как снимок заменит прежний
+         * \param file_name Имя файла снимка
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int save_snapshot(const std::string &file_name) {
+            std::lock_guard<std::mutex> snapshot_lock(snapshot_mutex);
+
+            /** \brief Копия баров периода символа
+             */
+            class SnapshotSeries {
+            public:
+                uint32_t symbol_id = 0;
+                uint32_t period = 0;
+                CandleArchive<CANDLE> archive;
+                std::vector<CANDLE> candles;
+            };
+
+            std::vector<SnapshotSeries> series;
+            bool is_journal = false;
+            {
+                std::lock_guard<std::mutex> journal_lock(tick_journal_mutex);
+                /* тики, уже переданные в пул, должны попасть в снимок */
+                if(aggregation_pool.running()) aggregation_pool.wait();
+                const uint32_t symbols_size = symbol_registry.size();
+                for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                    std::lock_guard<std::mutex> lock(candles_mutex[symbol_id]);
+                    for(auto &item : candles[symbol_id]) {
+                        series.emplace_back();
+                        SnapshotSeries &item_series = series.back();
+                        item_series.symbol_id = symbol_id;
+                        item_series.period = item.first;
+                        const CandleArchive<CANDLE> *archive = find_period_archive(symbol_id, item.first);
+                        if(archive) item_series.archive = *archive;
+                        item_series.candles.resize(item.second.size());
+                        item.second.copy(0, item_series.candles.size(), item_series.candles.data());
+                    }
+                }
+                if(is_tick_journal) {
+                    if(!tick_journal.rotate()) {
+                        std::cerr << "binomo api: BinomoApiPriceStream--->save_snapshot error, journal rotation" << std::endl;
+                        return common::DATA_NOT_AVAILABLE;
+                    }
+                    is_journal = true;
+                }
+            }
+
+            CandleSnapshot<CANDLE> snapshot;
+            if(!snapshot.open(file_name)) return common::DATA_NOT_AVAILABLE;
+            std::vector<CANDLE> buffer;
+            for(SnapshotSeries &item_series : series) {
+                const size_t archive_size = item_series.archive.size();
+                buffer.resize(archive_size + item_series.candles.size());
+                if(archive_size != 0) item_series.archive.copy(0, archive_size, buffer.data());
+                std::copy(item_series.candles.begin(), item_series.candles.end(), buffer.begin() + archive_size);
+                snapshot.write(symbol_registry.get_name(item_series.symbol_id), item_series.period, buffer.data(), buffer.size());
+                item_series = SnapshotSeries();
+            }
+            if(!snapshot.close()) {
+                std::cerr << "binomo api: BinomoApiPriceStream--->save_snapshot error, file = " << file_name << std::endl;
+                return common::DATA_NOT_AVAILABLE;
+            }
+            if(is_journal) {
+                std::lock_guard<std::mutex> journal_lock(tick_journal_mutex);
+                tick_journal.remove_segments();
+            }
+            return common::OK;
+        }
+
+        /** \brief Восстановить хранилище баров из снимка и журнала тиков
+         *
+         * Бары снимка объединяются с уже сохраненными барами, затем к ним применяются
+         * тики из журнала. Тики применяются только к подписанным периодам,
+         * функции обратного вызова баров при этом не вызываются.
+         * Метод нужно вызвать после add_candles_stream() и до start()
+         * \param file_name Имя файла снимка
+         * \param journal_file_name Имя файла журнала тиков, пустая строка - без журнала
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int load_snapshot(const std::string &file_name, const std::string &journal_file_name = std::string()) {
+            int err = CandleSnapshot<CANDLE>::read(file_name, [&](
+                    const std::string &symbol,
+                    const uint32_t period,
+                    const std::vector<CANDLE> &new_candles) {
+                const int err_symbol = init_array_candles(symbol, period, new_candles);
+                if(err_symbol == common::SYMBOL_LIMIT_REACHED) print_symbol_error(symbol, err_symbol);
+            });
+            if(err != common::OK && err != common::DATA_NOT_AVAILABLE) {
+                std::cerr << "binomo api: BinomoApiPriceStream--->load_snapshot error, file = " << file_name << std::endl;
+                return err;
+            }
+            if(journal_file_name.empty()) return err;
+            is_replay = true;
+            const int err_journal = TickJournal::read(journal_file_name, [&](
+                    const std::string &symbol,
+                    const double price,
+                    const xtime::ftimestamp_t timestamp) {
+                common::StreamTick tick;
+                tick.symbol_id = symbol_registry.get_id(symbol);
+                if(tick.symbol_id == SymbolRegistry::NONE) return;
+                tick.symbol = symbol_registry.get_name(tick.symbol_id);
+                tick.price = price;
+                tick.timestamp = timestamp;
+                tick.precision = symbol_registry.get_precision(tick.symbol_id);
+                PublishedTick published_tick;
+                published_tick.price = price;
+                published_tick.timestamp = timestamp;
+                published_ticks[tick.symbol_id].store(published_tick);
+                aggregate_tick(tick);
+            });
+            is_replay = false;
+            /* достаточно снимка или журнала */
+            if(err == common::OK || err_journal == common::OK) return common::OK;
+            return common::DATA_NOT_AVAILABLE;
+        }
+
+        /** \brief Открыть журнал тиков
+         *
+         * Все следующие тики записываются в журнал до очередного снимка
+         * \param file_name Имя файла журнала тиков
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int open_journal(const std::string &file_name) {
+            std::lock_guard<std::mutex> lock(tick_journal_mutex);
+            tick_journal.close();
+            if(!tick_journal.open(file_name)) {
+                is_tick_journal = false;
+                return common::DATA_NOT_AVAILABLE;
+            }
+            is_tick_journal = true;
+            return common::OK;
+        }
+
+        /** \brief Закрыть журнал тиков
+         */
+        void close_journal() {
+            std::lock_guard<std::mutex> lock(tick_journal_mutex);
+            is_tick_journal = false;
+            tick_journal.close();
+        }
+
+        /** \brief Включить параллельную обработку баров
+         *
+         * Тики распределяются по потокам пула по идентификатору символа,
+         * поэтому тики одного символа обрабатываются по порядку.
+         * Функции обратного вызова баров будут вызываться из потоков пула,
+         * функции обратного вызова тиков - по-прежнему из потока вебсокета.
+         * Метод нужно вызвать до start()
+         * \param num_threads Количество потоков, 0 - обработка в потоке вебсокета
+         * \return Вернет false, если поток котировок уже запущен
+         */
+        bool set_aggregation_threads(const size_t num_threads) {
+            if(client_future.valid()) return false;
+            aggregation_pool.stop();
+            if(num_threads == 0) return true;
+            return aggregation_pool.start(num_threads, [&](
+                    const size_t /*worker_index*/,
+                    std::vector<common::StreamTick> &ticks) {
+                /* маска символов пакета, см. SymbolRegistry::MAX_SYMBOLS */
+                static_assert(SymbolRegistry::MAX_SYMBOLS <= 64, "symbols_mask holds at most 64 symbols");
+                uint64_t symbols_mask = 0;
+                for(const common::StreamTick &tick : ticks) {
+                    aggregate_tick(tick);
+                    symbols_mask |= (uint64_t)1 << tick.symbol_id;
+                }
+                for(uint32_t symbol_id = 0; symbols_mask != 0; ++symbol_id, symbols_mask >>= 1) {
+                    if(symbols_mask & 1) flush_dispatch(symbol_id);
+                }
+                enforce_memory_budget();
+            });
+        }
+
+        /** \brief Включить очередь доставки событий
+         *
+         * Функции обратного вызова баров, исправлений баров и тиков
+         * (и методы приемников) будут вызываться из отдельного потока доставки,
+         * поэтому медленный обработчик не задерживает прием котировок.
+         * Порядок событий одного символа сохраняется.
+         * Функция обратного вызова пакета тиков on_ticks по-прежнему вызывается
+         * из потока вебсокета. Метод нужно вызвать до start()
+         * \param capacity Размер очереди, 0 - вызывать функции обратного вызова без очереди
+         * \param overflow_mode Режим переполнения очереди, см. DispatchOverflowType
+         * \return Вернет false, если поток котировок уже запущен или параметры неверны
+         */
+        bool set_dispatch_queue(const size_t capacity, const int overflow_mode = OVERFLOW_BLOCK) {
+            if(client_future.valid()) return false;
+            dispatch_queue.stop();
+            if(capacity == 0) return true;
+            return dispatch_queue.start(capacity, overflow_mode, [&](const DispatchEvent &event) {
+                dispatch_event(event);
+            });
+        }
+
+        /** \brief Включить параллельный вызов функций обратного вызова
+         *
+         * Функции обратного вызова баров, исправлений баров и тиков
+         * (и методы приемников) будут вызываться из потоков пула.
+         * События одного символа и периода передаются строго по порядку и никогда
+         * не обрабатываются одновременно, события разных символов и периодов
+         * обрабатываются параллельно. Свободный поток перехватывает работу
+         * у занятых потоков. Обработчики должны допускать одновременный вызов
+         * для разных символов. Вместе с очередью доставки пул получает события
+         * из потока доставки. Метод нужно вызвать до start()
+         * \param num_threads Количество потоков, 0 - без пула
+         * \return Вернет false, если поток котировок уже запущен
+         */
+        bool set_callback_threads(const size_t num_threads) {
+            if(client_future.valid()) return false;
+            callback_executor.stop();
+            if(num_threads == 0) return true;
+            const size_t num_strands = SymbolRegistry::MAX_SYMBOLS * CALLBACK_STRANDS;
+            return callback_executor.start(num_threads, num_strands, [&](const DispatchEvent &event) {
+                deliver_event(event);
+            });
+        }
+
+        /** \brief Получить состояние очереди доставки событий
+         * \return Размер очереди, наибольший размер, количество вытесненных и замененных событий
+         */
+        inline DispatchStats get_dispatch_stats() {
+            return dispatch_queue.get_stats();
+        }
+
+        /** \brief Подписаться на бары
+         *
+         * В отличие от on_candle подписчиков может быть несколько, и каждый получает
+         * только бары своего символа и периода. Обработчики вызываются после on_candle
+         * из того же потока, что и on_candle. Символ должен быть уже добавлен,
+         * см. add_candles_stream
+         * \param symbol_id Идентификатор символа или SubscriberRegistry<>::ANY_SYMBOL
+         * \param period Период или SubscriberRegistry<>::ANY_PERIOD
+         * \param closed_only Передавать только закрытые бары
+         * \param handler Обработчик бара
+         * \return Идентификатор подписки или 0, если символа нет или обработчик не задан
+         */
+        uint64_t subscribe_candles(
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const bool closed_only,
+                const typename SubscriberRegistry<CANDLE>::candle_handler_t &handler) {
+            if(symbol_id != SubscriberRegistry<CANDLE>::ANY_SYMBOL && !symbol_registry.check_id(symbol_id)) return 0;
+            return subscribers.subscribe_candles(
+                typename SubscriberRegistry<CANDLE>::Filter(symbol_id, period, closed_only), handler);
+        }
+
+        /** \brief Подписаться на бары
+         * \param symbol Имя символа
+         * \param period Период или SubscriberRegistry<>::ANY_PERIOD
+         * \param closed_only Передавать только закрытые бары
+         * \param handler Обработчик бара
+         * \return Идентификатор подписки или 0, если символа нет или обработчик не задан
+         */
+        inline uint64_t subscribe_candles(
+                const std::string &symbol,
+                const uint32_t period,
+                const bool closed_only,
+                const typename SubscriberRegistry<CANDLE>::candle_handler_t &handler) {
+            const uint32_t symbol_id = symbol_registry.get_id(symbol);
+            /* ANY_SYMBOL совпадает с SymbolRegistry::NONE, неизвестный символ не должен означать любой */
+            if(symbol_id == SymbolRegistry::NONE) return 0;
+            return subscribe_candles(symbol_id, period, closed_only, handler);
+        }
+
+        /** \brief Подписаться на исправления закрытых баров
+         *
+         * См. on_candle_correction
+         * \param symbol_id Идентификатор символа или SubscriberRegistry<>::ANY_SYMBOL
+         * \param period Период или SubscriberRegistry<>::ANY_PERIOD
+         * \param handler Обработчик исправленного бара
+         * \return Идентификатор подписки или 0, если символа нет или обработчик не задан
+         */
+        uint64_t subscribe_candle_corrections(
+                const uint32_t symbol_id,
+                const uint32_t period,
+                const typename SubscriberRegistry<CANDLE>::correction_handler_t &handler) {
+            if(symbol_id != SubscriberRegistry<CANDLE>::ANY_SYMBOL && !symbol_registry.check_id(symbol_id)) return 0;
+            return subscribers.subscribe_candle_corrections(
+                typename SubscriberRegistry<CANDLE>::Filter(symbol_id, period), handler);
+        }
+
+        /** \brief Подписаться на тики
+         * \param symbol_id Идентификатор символа или SubscriberRegistry<>::ANY_SYMBOL
+         * \param handler Обработчик тика
+         * \return Идентификатор подписки или 0, если символа нет или обработчик не задан
+         */
+        uint64_t subscribe_ticks(
+                const uint32_t symbol_id,
+                const typename SubscriberRegistry<CANDLE>::tick_handler_t &handler) {
+            if(symbol_id != SubscriberRegistry<CANDLE>::ANY_SYMBOL && !symbol_registry.check_id(symbol_id)) return 0;
+            return subscribers.subscribe_ticks(symbol_id, handler);
+        }
+
+        /** \brief Отписаться
+         * \param id Идентификатор подписки
+         * \return Вернет false, если подписки нет
+         */
+        inline bool unsubscribe(const uint64_t id) {
+            return subscribers.unsubscribe(id);
+        }
+
+        /** \brief Получить приемник баров
+         *
+         * Приемник вызывается из потока вебсокета, настраивать его нужно до start()
+         */
+        inline CANDLE_SINK &get_candle_sink() {
+            return candle_sink;
+        }
+
+        /** \brief Получить приемник тиков
+         *
+         * Приемник вызывается из потока вебсокета, настраивать его нужно до start()
+         */
+        inline TICK_SINK &get_tick_sink() {
+            return tick_sink;
         }
 #if(0)
 		/** \brief Получить количество знаков после запятой
@@ -786,7 +2683,12 @@ namespace binomo_api {
                         client->on_message =
                                 [&](std::shared_ptr<WssClient::Connection> connection,
                                 std::shared_ptr<WssClient::InMessage> message) {
-                            parser(message->string());
+                            const xtime::ftimestamp_t receive_timestamp = xtime::get_ftimestamp();
+                            /* буфер asio::streambuf непрерывный, читаем его на месте */
+                            const SimpleWeb::asio::streambuf *buffer =
+                                static_cast<const SimpleWeb::asio::streambuf*>(message->rdbuf());
+                            const auto data = buffer->data();
+                            parser(static_cast<const char*>(data.data()), data.size(), receive_timestamp);
                             //std::cout << "on_message " << message->string() << std::endl;
                         };
 
@@ -801,16 +2703,20 @@ namespace binomo_api {
                             /* вызываем функцию обратного вызова */
                             if(on_start != nullptr) on_start();
 
-                            /* подписываемся на поток котировок */
-                            std::list<std::string> list_symbol;
+                            /* подписываемся на поток котировок символов с подписками на бары,
+                             * символы из снимка или init_array_candles без подписки пропускаем
+                             */
+                            std::vector<std::string> list_symbol;
                             {
                                 std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
-                                if(list_subscriptions.size() == 0) return;
-                                for(auto &item_symbol : list_subscriptions) {
-                                    list_symbol.push_back(item_symbol.first);
+                                const uint32_t symbols_size = symbol_registry.size();
+                                for(uint32_t symbol_id = 0; symbol_id < symbols_size; ++symbol_id) {
+                                    if(list_subscriptions[symbol_id].empty()) continue;
+                                    list_symbol.push_back(symbol_registry.get_name(symbol_id));
                                 }
                             }
-                            subscribe_symbols(std::vector<std::string>(list_symbol.begin(), list_symbol.end()));
+                            if(list_symbol.empty()) return;
+                            subscribe_symbols(list_symbol);
                             std::cout << "binomo api: wss start" << std::endl;
                         };
 
@@ -46,6 +46,12 @@ namespace binomo_bot {
         int64_t timezone = 0;                               /**< Часовой пояс - смещение метки времени котировок на указанное число секунд */
         bool demo = true;                                   /**< Флаг демо аккаунта */
         int volume_mode = 0;                                /**< Режим работы объемов (0 - отключено, 1 - подсчет тиков, 2 - взвешенный подсчет тиков) */
+        std::string snapshot_file;                          /**< Файл снимка баров для быстрого перезапуска, пустая строка - не использовать */
+        uint32_t snapshot_period = 60;                      /**< Период сохранения снимка баров в секундах */
+        bool bar_close_timer = false;                       /**< Закрывать бары по времени сервера, не дожидаясь тика следующего бара */
+        uint32_t dispatch_queue_size = 0;                   /**< Размер очереди доставки баров, 0 - обрабатывать бары в потоке вебсокета */
+        int dispatch_overflow = 0;                          /**< Режим переполнения очереди доставки (0 - ждать, 1 - вытеснить старое событие, 2 - заменять незакрытые бары) */
+        uint32_t callback_threads = 0;                      /**< Количество потоков обработки баров разных символов, 0 - без пула потоков */
 
         bool is_error = false;
 
@@ -89,6 +95,12 @@ namespace binomo_bot {
                 if(j["candles"] != nullptr) candles = j["candles"];
                 if(j["timezone"] != nullptr) timezone = j["timezone"];
                 if(j["path"] != nullptr) path = j["path"];
+                if(j["snapshot_file"] != nullptr) snapshot_file = j["snapshot_file"];
+                if(j["snapshot_period"] != nullptr) snapshot_period = j["snapshot_period"];
+                if(j["bar_close_timer"] != nullptr) bar_close_timer = j["bar_close_timer"];
+                if(j["dispatch_queue_size"] != nullptr) dispatch_queue_size = j["dispatch_queue_size"];
+                if(j["dispatch_overflow"] != nullptr) dispatch_overflow = j["dispatch_overflow"];
+                if(j["callback_threads"] != nullptr) callback_threads = j["callback_threads"];
                 if(j["symbols"] != nullptr && j["symbols"].is_array()) {
                     const size_t symbols_size = j["symbols"].size();
                     for(size_t i = 0; i < symbols_size; ++i) {
@@ -116,6 +116,82 @@ namespace binomo_bot {
             }
         }
 
+        /** \brief Получить имя символа для файла исторических данных MQL
+         *
+         * Секундные бары пишутся в отдельный символ с суффиксом S,
+         * чтобы их файл не совпал с файлом минутных баров того же числа
+         * \param settings Настройки API
+         * \param i Индекс символа в настройках
+         * \return Имя символа, не длиннее 11 символов
+         */
+        static std::string get_mql_symbol_name(const Settings &settings, const size_t i) {
+            std::string mql_symbol_name = settings.symbols[i].first + settings.symbol_hst_suffix;
+            if(settings.symbols[i].second < xtime::SECONDS_IN_MINUTE) {
+                if(mql_symbol_name.size() >= 10) mql_symbol_name = mql_symbol_name.substr(0,10);
+                return mql_symbol_name + "S";
+            }
+            if(mql_symbol_name.size() >= 11) mql_symbol_name = mql_symbol_name.substr(0,11);
+            return mql_symbol_name;
+        }
+
+        /** \brief Получить метку времени окончания загрузки истории
+         *
+         * Для секундных периодов история загружается до начала текущего бара,
+         * для остальных - до начала текущей минуты
+         * \param period Период
+         * \return Метка времени окончания истории
+         */
+        static xtime::timestamp_t get_history_stop_date(const uint32_t period) {
+            if(period >= xtime::SECONDS_IN_MINUTE) return xtime::get_first_timestamp_minute();
+            const xtime::timestamp_t timestamp = xtime::get_timestamp();
+            return timestamp - (timestamp % period);
+        }
+
+        /** \brief Загрузить недостающие исторические данные символа
+         *
+         * Бары, восстановленные из снимка и журнала тиков, и бары потока котировок
+         * уже лежат в хранилище потока. По HTTP загружается только пропуск между
+         * ними или вся история, если восстановленных баров нет
+         * \param settings Настройки API
+         * \param i Индекс символа в настройках
+         * \param stop_date Метка времени окончания истории
+         * \param candles Бары истории, не новее stop_date
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int load_history_gap(
+                Settings &settings,
+                const size_t i,
+                const xtime::timestamp_t stop_date,
+                std::vector<binomo_api::common::Candle> &candles) {
+            const std::string &symbol = settings.symbols[i].first;
+            const uint32_t period = settings.symbols[i].second;
+            const uint32_t symbol_id = candlestick_streams->get_symbol_id(symbol);
+            xtime::timestamp_t start_date = stop_date - (period * settings.candles);
+
+            /* ищем начало последнего непрерывного участка баров */
+            candles.resize(settings.candles);
+            size_t num_candles = candlestick_streams->get_last_candles(symbol_id, period, 0, settings.candles, candles.data());
+            if(num_candles > 0) {
+                size_t n = num_candles - 1;
+                while(n > 0 && candles[n].timestamp - candles[n - 1].timestamp == period) --n;
+                if(n > 0) start_date = std::max(start_date, candles[n - 1].timestamp);
+                else if(num_candles >= settings.candles) start_date = stop_date;
+            }
+
+            int err = binomo_api::common::OK;
+            if(start_date < stop_date) {
+                std::vector<binomo_api::common::Candle> gap_candles;
+                err = binomo_http_api->get_historical_data(gap_candles, symbol, period, start_date, stop_date);
+                if(!gap_candles.empty()) candlestick_streams->init_array_candles(symbol, period, gap_candles);
+            }
+
+            candles.resize(settings.candles);
+            num_candles = candlestick_streams->get_last_candles(symbol_id, period, 0, settings.candles, candles.data());
+            candles.resize(num_candles);
+            while(!candles.empty() && candles.back().timestamp > stop_date) candles.pop_back();
+            return err;
+        }
+
     public:
 
         /** \brief Инициализация главных компонент API
@@ -156,9 +232,6 @@ namespace binomo_bot {
 				case 5:
 				case 15:
 				case 30:
-                    std::cerr << "binomo bot: period " << settings.symbols[i].second << " does not exist!" << std::endl;
-					return false;
-                    break;
 				case xtime::SECONDS_IN_MINUTE:
 				case (5 * xtime::SECONDS_IN_MINUTE):
 				case (15 * xtime::SECONDS_IN_MINUTE):
@@ -168,6 +241,8 @@ namespace binomo_bot {
 				case xtime::SECONDS_IN_DAY:
 					continue;
 				default:
+                    /* остальные минутные периоды собираются из баров меньшего периода */
+                    if(settings.symbols[i].second % xtime::SECONDS_IN_MINUTE == 0) continue;
 					std::cerr << "binomo bot: period " << settings.symbols[i].second << " does not exist!" << std::endl;
 					return false;
 					break;
@@ -201,12 +276,13 @@ namespace binomo_bot {
 
             /* инициализируем исторические данные MQL */
             for(size_t i = 0; i < settings.symbols.size(); ++i) {
-                std::string mql_symbol_name = settings.symbols[i].first + settings.symbol_hst_suffix;
-                if(mql_symbol_name.size() >= 11) mql_symbol_name = mql_symbol_name.substr(0,11);
+                /* у MT4 нет секундных периодов, поэтому секундные бары пишем с периодом в секундах */
+                const uint32_t mql_period = settings.symbols[i].second < xtime::SECONDS_IN_MINUTE ?
+                    settings.symbols[i].second : settings.symbols[i].second/xtime::SECONDS_IN_MINUTE;
                 mql_history.push_back(std::make_shared<binomo_api::MqlHst<>>(
-                    mql_symbol_name,
+                    get_mql_symbol_name(settings, i),
                     settings.path,
-                    settings.symbols[i].second/xtime::SECONDS_IN_MINUTE,
+                    mql_period,
                     std::min(precisions[i], settings.max_precisions),
                     settings.timezone));
             }
@@ -220,107 +296,141 @@ namespace binomo_bot {
                 //is_once_mql_history[i] = false;
             }
 
-            /* инициализируем callback функцию потока котировок */
-            candlestick_streams->on_candle = [&](
-                    const std::string &symbol,
+            /* обновление исторических данных MQL барами потока котировок,
+             * обращается только к членам класса, поэтому подписки хранят копию
+             */
+            auto update_mql_history = [this](
+                    const size_t i,
+                    const uint32_t symbol_id,
                     const binomo_api::common::Candle &candle,
                     const uint32_t period,
                     const bool close_candle) {
-                //std::cout << "--symbol " << symbol << std::endl;
-                /* получаем размер массива исторических даных MQL */
-                size_t mql_history_size = 0;
+                /* проверяем наличие инициализации исторических данных */
+                if(is_init_mql_history[i] == false) return;
+
+                /* получаем последнюю метку времени исторических данных */
+                xtime::timestamp_t last_timestamp = 0;
                 {
                     std::lock_guard<std::mutex> lock(mql_history_mutex);
-                    mql_history_size = mql_history.size();
+                    last_timestamp = mql_history[i]->get_last_timestamp();
                 }
 
-                if(mql_history_size != 0) {
-                    for(size_t i = 0; i < mql_history_size; ++i) {
-                        /* проверяем соответствие параметров символа */
-                        if(settings.symbols[i].first != symbol || settings.symbols[i].second != period) continue;
-
-                        /* проверяем наличие инициализации исторических данных */
-                        if(is_init_mql_history[i] == false) continue;
-
-                        /* получаем последнюю метку времени исторических данных */
-                        xtime::timestamp_t last_timestamp = 0;
-                        {
-                            std::lock_guard<std::mutex> lock(mql_history_mutex);
-                            last_timestamp = mql_history[i]->get_last_timestamp();
-                        }
-
-                        /* проверяем, была ли только что загрузка исторических данных */
-                        if(is_once_mql_history[i] == false) {
-                            ///std::cout << "TIME once last_timestamp " << xtime::get_str_date_time(last_timestamp) << std::endl;
-                            ///std::cout << "TIME once candle.timestamp " << xtime::get_str_date_time(candle.timestamp) << " close_candle " << close_candle << std::endl;
-                            /* проверяем, не успел ли прийти новый бар,
-                             * пока мы загружали исторические данных
-                             */
-                            if(candle.timestamp > last_timestamp) {
-                                /* добавляем пропущенные исторические данные, не включая текущий бар */
-                                const xtime::timestamp_t step_time = period;// * xtime::SECONDS_IN_MINUTE;
-
-                                //std::cout << "step_time " << step_time << std::endl;
-
-                                for(xtime::timestamp_t t = last_timestamp; t < candle.timestamp; t += step_time) {
-                                    binomo_api::common::Candle streams_old_candle = candlestick_streams->get_timestamp_candle(symbol, period, t);
-                                    std::lock_guard<std::mutex> lock(mql_history_mutex);
-                                    mql_history[i]->add_new_candle_with_memory(streams_old_candle);
-                                    ///std::cout << "TIME once " << xtime::get_str_date_time(t) << std::endl;
-                                }
-                            }
-                            {
-                                std::lock_guard<std::mutex> lock(mql_history_mutex);
-                                mql_history[i]->update_candle_with_memory(candle);
-                                if(close_candle) {
-                                    mql_history[i]->add_new_candle_with_memory(candle);
-                                }
-                            }
-                            is_once_mql_history[i] = true;
-                            continue;
+                /* проверяем, была ли только что загрузка исторических данных */
+                if(is_once_mql_history[i] == false) {
+                    ///std::cout << "TIME once last_timestamp " << xtime::get_str_date_time(last_timestamp) << std::endl;
+                    ///std::cout << "TIME once candle.timestamp " << xtime::get_str_date_time(candle.timestamp) << " close_candle " << close_candle << std::endl;
+                    /* проверяем, не успел ли прийти новый бар,
+                     * пока мы загружали исторические данных
+                     */
+                    if(candle.timestamp > last_timestamp) {
+                        /* добавляем пропущенные исторические данные, не включая текущий бар */
+                        const xtime::timestamp_t step_time = period;// * xtime::SECONDS_IN_MINUTE;
+
+                        //std::cout << "step_time " << step_time << std::endl;
+
+                        /* все пропущенные бары копируем одним запросом */
+                        const size_t max_candles = (candle.timestamp - last_timestamp + step_time - 1) / step_time;
+                        std::vector<binomo_api::common::Candle> streams_old_candles(max_candles);
+                        const size_t num_candles = candlestick_streams->get_candles(
+                            symbol_id, period, last_timestamp, max_candles, streams_old_candles.data());
+                        std::lock_guard<std::mutex> lock(mql_history_mutex);
+                        for(size_t n = 0; n < num_candles; ++n) {
+                            if(streams_old_candles[n].timestamp >= candle.timestamp) break;
+                            mql_history[i]->add_new_candle_with_memory(streams_old_candles[n]);
+                            ///std::cout << "TIME once " << xtime::get_str_date_time(streams_old_candles[n].timestamp) << std::endl;
                         }
-
-                        /* если параметры соответствуют, обновляем исторические данные */
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mql_history_mutex);
+                        mql_history[i]->update_candle_with_memory(candle);
                         if(close_candle) {
-                            std::lock_guard<std::mutex> lock(mql_history_mutex);
                             mql_history[i]->add_new_candle_with_memory(candle);
-                        } else {
-                            std::lock_guard<std::mutex> lock(mql_history_mutex);
-                            mql_history[i]->update_candle_with_memory(candle);
                         }
                     }
+                    is_once_mql_history[i] = true;
+                    return;
+                }
+
+                /* если параметры соответствуют, обновляем исторические данные */
+                if(close_candle) {
+                    std::lock_guard<std::mutex> lock(mql_history_mutex);
+                    mql_history[i]->add_new_candle_with_memory(candle);
+                } else {
+                    std::lock_guard<std::mutex> lock(mql_history_mutex);
+                    mql_history[i]->update_candle_with_memory(candle);
                 }
-#               if(0)
-                /* выводим сообщение о символе */
-                std::cout
-                    << symbol
-                    //<< " o: " << candle.open
-                    << " c: " << candle.close
-                    //<< " h: " << candle.high
-                    //<< " l: " << candle.low
-                    << " v: " << candle.volume
-                    << " p: " << period
-                    << " t: " << xtime::get_str_time(candle.timestamp)
-                    << " cc: " << close_candle
-                    << std::endl;
-#               endif
             };
 
             /* инициализируем потоки котировок */
             candlestick_streams->add_candles_stream(settings.symbols);
+
+            /* символы получили идентификаторы, каждый файл MQL подписываем только на свой символ и период */
+            for(size_t i = 0; i < settings.symbols.size(); ++i) {
+                const uint32_t symbol_id = candlestick_streams->get_symbol_id(settings.symbols[i].first);
+                /* неизвестный символ нельзя передавать в подписку, его идентификатор совпадает с ANY_SYMBOL */
+                if(!candlestick_streams->get_symbol_registry().check_id(symbol_id)) continue;
+                const uint32_t period = settings.symbols[i].second;
+                candlestick_streams->subscribe_candles(symbol_id, period, false, [update_mql_history, i](
+                        const uint32_t symbol_id,
+                        const binomo_api::common::Candle &candle,
+                        const uint32_t period,
+                        const bool close_candle) {
+                    update_mql_history(i, symbol_id, candle, period, close_candle);
+                });
+                /* опоздавший тик уже закрытого бара исправляет бар в исторических данных MQL */
+                candlestick_streams->subscribe_candle_corrections(symbol_id, period, [this, i](
+                        const uint32_t /*symbol_id*/,
+                        const binomo_api::common::Candle &candle,
+                        const uint32_t /*period*/) {
+                    if(is_once_mql_history[i] == false) return;
+                    std::lock_guard<std::mutex> lock(mql_history_mutex);
+                    mql_history[i]->correct_candle(candle);
+                });
+            }
+
+            /* секундным периодам сразу выделяем место под бары */
+            for(size_t i = 0; i < settings.symbols.size(); ++i) {
+                if(settings.symbols[i].second >= xtime::SECONDS_IN_MINUTE) continue;
+                candlestick_streams->set_retention(settings.symbols[i].second, settings.candles);
+            }
+
+            /* восстанавливаем бары из снимка и журнала тиков */
+            if(!settings.snapshot_file.empty()) {
+                for(size_t i = 0; i < settings.symbols.size(); ++i) {
+                    candlestick_streams->set_retention(settings.symbols[i].second, settings.candles);
+                }
+                const std::string journal_file = settings.snapshot_file + ".journal";
+                const int err = candlestick_streams->load_snapshot(settings.snapshot_file, journal_file);
+                std::cout << "binomo bot: snapshot " << settings.snapshot_file << ", error code = " << err << std::endl;
+                candlestick_streams->open_journal(journal_file);
+            }
+            /* запись исторических данных MQL выполняем вне потока вебсокета */
+            if(settings.dispatch_queue_size != 0 &&
+                !candlestick_streams->set_dispatch_queue(settings.dispatch_queue_size, settings.dispatch_overflow)) {
+                std::cerr << "binomo bot: dispatch queue error, size " << settings.dispatch_queue_size
+                    << ", overflow " << settings.dispatch_overflow << std::endl;
+            }
+            /* бары разных символов записываем параллельно */
+            if(settings.callback_threads != 0) candlestick_streams->set_callback_threads(settings.callback_threads);
             candlestick_streams->start();
             candlestick_streams->wait();
+            if(settings.bar_close_timer) candlestick_streams->set_bar_close_timer(true);
 
             /* ждем, чтобы котировки прогрузились */
             std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 
             /* загружаем исторические данные */
             for(size_t i = 0; i < settings.symbols.size(); ++i) {
-                const xtime::timestamp_t stop_date = xtime::get_first_timestamp_minute();
+                const xtime::timestamp_t stop_date = get_history_stop_date(settings.symbols[i].second);
                 const xtime::timestamp_t start_date = stop_date - (settings.symbols[i].second * settings.candles);
                 std::vector<binomo_api::common::Candle> candles;
 
-                int err = binomo_http_api->get_historical_data(candles, settings.symbols[i].first, settings.symbols[i].second, start_date, stop_date);
+                int err = binomo_api::common::OK;
+                if(settings.snapshot_file.empty()) {
+                    err = binomo_http_api->get_historical_data(candles, settings.symbols[i].first, settings.symbols[i].second, start_date, stop_date);
+                } else {
+                    err = load_history_gap(settings, i, stop_date, candles);
+                }
 
                 for(size_t c = 0; c < candles.size(); ++c) {
                     binomo_api::common::Candle candle = candles[c];
@@ -334,9 +444,24 @@ namespace binomo_bot {
                 /* ставим флаг инициализации исторических данных */
                 is_init_mql_history[i] = true;
 
-                std::string mql_symbol_name = settings.symbols[i].first + settings.symbol_hst_suffix;
-                if(mql_symbol_name.size() >= 11) mql_symbol_name = mql_symbol_name.substr(0,11);
-                std::cout << "binomo bot: " << settings.symbols[i].first << " initialized as " << mql_symbol_name << ", candles = " << candles.size() << ", error code = " << err << std::endl;
+                std::cout << "binomo bot: " << settings.symbols[i].first << " initialized as " << get_mql_symbol_name(settings, i) << ", candles = " << candles.size() << ", error code = " << err << std::endl;
+            }
+
+            /* периодически сохраняем снимок баров */
+            if(!settings.snapshot_file.empty()) {
+                std::lock_guard<std::mutex> lock(request_future_mutex);
+                request_future.push_back(std::async(std::launch::async, [&, settings]() {
+                    const std::chrono::milliseconds step(100);
+                    const auto snapshot_period = std::chrono::seconds(std::max(settings.snapshot_period, (uint32_t)1));
+                    auto last_save = std::chrono::steady_clock::now();
+                    while(!is_future_shutdown) {
+                        std::this_thread::sleep_for(step);
+                        if(std::chrono::steady_clock::now() - last_save < snapshot_period) continue;
+                        candlestick_streams->save_snapshot(settings.snapshot_file);
+                        last_save = std::chrono::steady_clock::now();
+                    }
+                    candlestick_streams->save_snapshot(settings.snapshot_file);
+                }));
             }
             return true;
         }
@@ -0,0 +1,490 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_ASSETS_PARSER_HPP_INCLUDED
+#define BINOMO_CPP_API_ASSETS_PARSER_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include "binomo-cpp-api-iso-time.hpp"
+#include "binomo-cpp-api-symbol-registry.hpp"
+#include <array>
+#include <cstring>
+#include <cstdlib>
+
+namespace binomo_api {
+
+    /** \brief Парсер сообщений потока котировок с действием "assets"
+     *
+     * Разбирает сообщения вида
+     * {"data":[{"assets":[{"rate":...,"precision":...,"created_at":"...","ric":"..."}],"action":"assets"}],"success":true,"errors":[]}
+     * напрямую в массив тиков, без построения DOM и без выделения памяти в куче.
+     * Тики записываются во внутренний буфер фиксированного размера,
+     * который переиспользуется между сообщениями.
+     * Сообщения с другими действиями (например, "subscribe") парсер
+     * не разбирает и возвращает UNSUPPORTED_MESSAGE, чтобы их можно было
+     * передать обычному парсеру JSON.
+     */
+    template<size_t MAX_TICKS = 64>
+    class AssetsParser {
+    private:
+        static const size_t MAX_STRING_SIZE = 64;   /**< Максимальный размер строкового значения */
+        static const uint32_t MAX_EXACT_DIGITS = 15; /**< Наибольшее количество цифр числа, которое разбирается без strtod */
+
+        std::array<common::StreamTick, MAX_TICKS> ticks;
+        std::array<xtime::ftimestamp_t, MAX_TICKS> ftimestamps;
+        size_t ticks_size = 0;
+
+        SymbolRegistry &registry;                   /**< Реестр символов потока котировок */
+        IsoTimeDecoder iso_decoder;                 /**< Декодер даты, запоминает последнюю дату и секунду */
+        const char *it = nullptr;
+        const char *it_end = nullptr;
+
+        /** \brief Строковое значение без кавычек
+         */
+        class StringValue {
+        public:
+            const char *data = nullptr;
+            size_t size = 0;
+            char buffer[MAX_STRING_SIZE];           /**< Буфер для строк с экранированными символами */
+
+            inline bool equal(const char *str, const size_t length) const {
+                return size == length && std::memcmp(data, str, length) == 0;
+            }
+        };
+
+        inline void skip_spaces() {
+            while(it < it_end && (*it == ' ' || *it == '\n' || *it == '\r' || *it == '\t')) ++it;
+        }
+
+        inline bool expect(const char c) {
+            skip_spaces();
+            if(it == it_end || *it != c) return false;
+            ++it;
+            return true;
+        }
+
+        /** \brief Прочитать строку
+         *
+         * Строки без экранирования не копируются. Экранированные символы
+         * раскрываются во внутренний буфер, кроме \\uXXXX
+         * \param value Строковое значение
+         * \return Код ошибки
+         */
+        int read_string(StringValue &value) {
+            if(!expect('"')) return common::JSON_PARSER_ERROR;
+            const char *beg = it;
+            while(it < it_end && *it != '"' && *it != '\\') ++it;
+            if(it == it_end) return common::JSON_PARSER_ERROR;
+            if(*it == '"') {
+                value.data = beg;
+                value.size = it - beg;
+                ++it;
+                return common::OK;
+            }
+            /* встретили экранирование, копируем строку в буфер */
+            size_t size = it - beg;
+            if(size >= MAX_STRING_SIZE) return common::UNSUPPORTED_MESSAGE;
+            std::memcpy(value.buffer, beg, size);
+            while(it < it_end && *it != '"') {
+                char c = *it++;
+                if(c == '\\') {
+                    if(it == it_end) return common::JSON_PARSER_ERROR;
+                    c = *it++;
+                    switch(c) {
+                    case '"':
+                    case '\\':
+                    case '/':
+                        break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'n': c = '\n'; break;
+                    case 'r': c = '\r'; break;
+                    case 't': c = '\t'; break;
+                    default:
+                        return common::UNSUPPORTED_MESSAGE;
+                    }
+                }
+                if(size >= MAX_STRING_SIZE) return common::UNSUPPORTED_MESSAGE;
+                value.buffer[size++] = c;
+            }
+            if(it == it_end) return common::JSON_PARSER_ERROR;
+            ++it;
+            value.data = value.buffer;
+            value.size = size;
+            return common::OK;
+        }
+
+        /** \brief Пропустить строку
+         * \return Код ошибки
+         */
+        int skip_string() {
+            if(!expect('"')) return common::JSON_PARSER_ERROR;
+            while(it < it_end && *it != '"') {
+                if(*it == '\\') ++it;
+                ++it;
+            }
+            if(it >= it_end) return common::JSON_PARSER_ERROR;
+            ++it;
+            return common::OK;
+        }
+
+        /** \brief Пропустить значение любого типа
+         * \return Код ошибки
+         */
+        int skip_value() {
+            skip_spaces();
+            if(it == it_end) return common::JSON_PARSER_ERROR;
+            if(*it == '"') return skip_string();
+            if(*it != '{' && *it != '[') {
+                const char *beg = it;
+                while(it < it_end &&
+                    *it != ',' && *it != '}' && *it != ']' &&
+                    *it != ' ' && *it != '\n' && *it != '\r' && *it != '\t') ++it;
+                return it == beg ? common::JSON_PARSER_ERROR : common::OK;
+            }
+            size_t depth = 0;
+            while(it < it_end) {
+                const char c = *it;
+                if(c == '"') {
+                    if(skip_string() != common::OK) return common::JSON_PARSER_ERROR;
+                    continue;
+                }
+                ++it;
+                if(c == '{' || c == '[') ++depth;
+                else if(c == '}' || c == ']') {
+                    if(--depth == 0) return common::OK;
+                }
+            }
+            return common::JSON_PARSER_ERROR;
+        }
+
+        /** \brief Прочитать литерал true или false
+         * \param value Значение
+         * \return Код ошибки
+         */
+        int read_bool(bool &value) {
+            skip_spaces();
+            const size_t size = it_end - it;
+            if(size >= 4 && std::memcmp(it, "true", 4) == 0) {
+                value = true;
+                it += 4;
+                return common::OK;
+            }
+            if(size >= 5 && std::memcmp(it, "false", 5) == 0) {
+                value = false;
+                it += 5;
+                return common::OK;
+            }
+            return skip_value() == common::OK ? common::PARSER_ERROR : common::JSON_PARSER_ERROR;
+        }
+
+        /** \brief Прочитать число
+         *
+         * Числа без экспоненты с количеством цифр не более 15 собираются
+         * как целая мантисса и делятся на степень 10. Мантисса меньше 2^53
+         * и степень 10 представимы в double точно, поэтому единственное деление
+         * округляется так же, как strtod. Остальные числа копируются в буфер
+         * на стеке и разбираются через strtod.
+         * \param value Значение
+         * \return Код ошибки
+         */
+        int read_number(double &value) {
+            static const double pow10[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                1e11, 1e12, 1e13, 1e14, 1e15
+            };
+            skip_spaces();
+            const char *beg = it;
+            bool is_negative = false;
+            if(it < it_end && *it == '-') {
+                is_negative = true;
+                ++it;
+            }
+            uint64_t mantissa = 0;
+            uint32_t digits = 0;
+            uint32_t decimals = 0;
+            while(it < it_end && *it >= '0' && *it <= '9') {
+                mantissa = mantissa * 10 + (*it++ - '0');
+                ++digits;
+            }
+            if(it < it_end && *it == '.') {
+                ++it;
+                while(it < it_end && *it >= '0' && *it <= '9') {
+                    mantissa = mantissa * 10 + (*it++ - '0');
+                    ++digits;
+                    ++decimals;
+                }
+            }
+            if(digits == 0) return common::JSON_PARSER_ERROR;
+            if(it < it_end && (*it == 'e' || *it == 'E')) {
+                ++it;
+                if(it < it_end && (*it == '+' || *it == '-')) ++it;
+                while(it < it_end && *it >= '0' && *it <= '9') ++it;
+                digits = MAX_EXACT_DIGITS + 1;
+            }
+            if(digits <= MAX_EXACT_DIGITS) {
+                value = (double)mantissa / pow10[decimals];
+                if(is_negative) value = -value;
+                return common::OK;
+            }
+            char buffer[MAX_STRING_SIZE];
+            const size_t size = it - beg;
+            if(size >= MAX_STRING_SIZE) return common::UNSUPPORTED_MESSAGE;
+            std::memcpy(buffer, beg, size);
+            buffer[size] = '\0';
+            value = std::strtod(buffer, nullptr);
+            return common::OK;
+        }
+
+        /** \brief Разобрать элемент массива "assets"
+         * \return Код ошибки
+         */
+        int parse_asset() {
+            if(!expect('{')) return common::JSON_PARSER_ERROR;
+            if(ticks_size >= MAX_TICKS) return common::UNSUPPORTED_MESSAGE;
+            common::StreamTick &tick = ticks[ticks_size];
+            tick.precision = 0;
+            bool is_rate = false, is_ric = false, is_date = false;
+            xtime::ftimestamp_t ftimestamp = 0;
+            StringValue key, value;
+            skip_spaces();
+            if(it < it_end && *it == '}') {
+                ++it;
+                return common::PARSER_ERROR;
+            }
+            while(true) {
+                int err = read_string(key);
+                if(err != common::OK) return err;
+                if(!expect(':')) return common::JSON_PARSER_ERROR;
+                if(key.equal("rate", 4)) {
+                    if((err = read_number(tick.price)) != common::OK) return err;
+                    is_rate = true;
+                } else
+                if(key.equal("precision", 9)) {
+                    double precision = 0;
+                    if((err = read_number(precision)) != common::OK) return err;
+                    tick.precision = (uint32_t)precision;
+                } else
+                if(key.equal("ric", 3)) {
+                    if((err = read_string(value)) != common::OK) return err;
+                    /* символы регистрируются при подписке, тики остальных символов пропускаем */
+                    tick.symbol_id = registry.find_ric(value.data, value.size);
+                    is_ric = true;
+                } else
+                if(key.equal("created_at", 10)) {
+                    if((err = read_string(value)) != common::OK) return err;
+                    is_date = iso_decoder.decode(value.data, value.size, ftimestamp);
+                } else {
+                    if((err = skip_value()) != common::OK) return err;
+                }
+                skip_spaces();
+                if(it == it_end) return common::JSON_PARSER_ERROR;
+                if(*it == ',') {
+                    ++it;
+                    continue;
+                }
+                if(*it != '}') return common::JSON_PARSER_ERROR;
+                ++it;
+                break;
+            }
+            if(!is_rate || !is_ric) return common::PARSER_ERROR;
+            /* тики неизвестных символов и тики с ошибкой в дате пропускаем */
+            if(!is_date) return common::OK;
+            if(tick.symbol_id == SymbolRegistry::NONE) return common::OK;
+            tick.symbol = registry.get_name(tick.symbol_id);
+            tick.timestamp = (xtime::timestamp_t)ftimestamp;
+            ftimestamps[ticks_size] = ftimestamp;
+            ++ticks_size;
+            return common::OK;
+        }
+
+        /** \brief Разобрать массив "assets"
+         * \return Код ошибки
+         */
+        int parse_assets() {
+            if(!expect('[')) return common::JSON_PARSER_ERROR;
+            skip_spaces();
+            if(it < it_end && *it == ']') {
+                ++it;
+                return common::OK;
+            }
+            while(true) {
+                const int err = parse_asset();
+                if(err != common::OK) return err;
+                skip_spaces();
+                if(it == it_end) return common::JSON_PARSER_ERROR;
+                if(*it == ',') {
+                    ++it;
+                    continue;
+                }
+                if(*it != ']') return common::JSON_PARSER_ERROR;
+                ++it;
+                return common::OK;
+            }
+        }
+
+        /** \brief Разобрать элемент массива "data"
+         * \return Код ошибки
+         */
+        int parse_data_element() {
+            if(!expect('{')) return common::JSON_PARSER_ERROR;
+            bool is_assets_action = false;
+            StringValue key, value;
+            skip_spaces();
+            if(it < it_end && *it == '}') return common::UNSUPPORTED_MESSAGE;
+            while(true) {
+                int err = read_string(key);
+                if(err != common::OK) return err;
+                if(!expect(':')) return common::JSON_PARSER_ERROR;
+                if(key.equal("assets", 6)) {
+                    if((err = parse_assets()) != common::OK) return err;
+                } else
+                if(key.equal("action", 6)) {
+                    if((err = read_string(value)) != common::OK) return err;
+                    is_assets_action = value.equal("assets", 6);
+                } else {
+                    if((err = skip_value()) != common::OK) return err;
+                }
+                skip_spaces();
+                if(it == it_end) return common::JSON_PARSER_ERROR;
+                if(*it == ',') {
+                    ++it;
+                    continue;
+                }
+                if(*it != '}') return common::JSON_PARSER_ERROR;
+                ++it;
+                break;
+            }
+            /* другие действия разбирает обычный парсер */
+            if(!is_assets_action) return common::UNSUPPORTED_MESSAGE;
+            return common::OK;
+        }
+
+        /** \brief Разобрать массив "data"
+         * \return Код ошибки
+         */
+        int parse_data() {
+            if(!expect('[')) return common::JSON_PARSER_ERROR;
+            skip_spaces();
+            if(it < it_end && *it == ']') {
+                ++it;
+                return common::OK;
+            }
+            while(true) {
+                const int err = parse_data_element();
+                if(err != common::OK) return err;
+                skip_spaces();
+                if(it == it_end) return common::JSON_PARSER_ERROR;
+                if(*it == ',') {
+                    ++it;
+                    continue;
+                }
+                if(*it != ']') return common::JSON_PARSER_ERROR;
+                ++it;
+                return common::OK;
+            }
+        }
+
+    public:
+
+        /** \brief Конструктор парсера
+         * \param user_registry Реестр символов, по которому RIC переводится в идентификатор символа
+         */
+        AssetsParser(SymbolRegistry &user_registry) : registry(user_registry) {};
+
+        /** \brief Разобрать сообщение потока котировок
+         *
+         * Сообщение может не заканчиваться нулевым символом.
+         * \param data Указатель на начало сообщения
+         * \param length Длина сообщения
+         * \return Код ошибки. OK - сообщение разобрано, тики доступны через data() и size().
+         * UNSUPPORTED_MESSAGE - сообщение нужно разобрать обычным парсером.
+         * JSON_PARSER_ERROR или PARSER_ERROR - сообщение содержит ошибку
+         */
+        int parse(const char *data, const size_t length) {
+            ticks_size = 0;
+            it = data;
+            it_end = data + length;
+            bool success = false;
+            StringValue key;
+            if(!expect('{')) return common::JSON_PARSER_ERROR;
+            skip_spaces();
+            if(it < it_end && *it == '}') return common::UNSUPPORTED_MESSAGE;
+            int err = common::OK;
+            while(true) {
+                if((err = read_string(key)) != common::OK) break;
+                if(!expect(':')) {
+                    err = common::JSON_PARSER_ERROR;
+                    break;
+                }
+                if(key.equal("data", 4)) {
+                    if((err = parse_data()) != common::OK) break;
+                } else
+                if(key.equal("success", 7)) {
+                    if((err = read_bool(success)) != common::OK) break;
+                } else {
+                    if((err = skip_value()) != common::OK) break;
+                }
+                skip_spaces();
+                if(it == it_end) {
+                    err = common::JSON_PARSER_ERROR;
+                    break;
+                }
+                if(*it == ',') {
+                    ++it;
+                    continue;
+                }
+                if(*it != '}') err = common::JSON_PARSER_ERROR;
+                else ++it;
+                break;
+            }
+            if(err == common::OK) {
+                skip_spaces();
+                if(it != it_end) err = common::JSON_PARSER_ERROR;
+            }
+            if(err != common::OK || !success) ticks_size = 0;
+            return err;
+        }
+
+        /** \brief Получить указатель на массив тиков последнего сообщения
+         */
+        inline const common::StreamTick *data() const {
+            return ticks.data();
+        }
+
+        /** \brief Получить количество тиков последнего сообщения
+         */
+        inline size_t size() const {
+            return ticks_size;
+        }
+
+        /** \brief Получить метку времени тика с дробной частью
+         * \param index Индекс тика
+         */
+        inline xtime::ftimestamp_t get_ftimestamp(const size_t index) const {
+            return ftimestamps[index];
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_ASSETS_PARSER_HPP_INCLUDED
@@ -0,0 +1,329 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_ARCHIVE_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_ARCHIVE_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+namespace binomo_api {
+
+    /** \brief Сжатое хранилище старых баров
+     *
+     * Бары добавляются только в конец, в порядке возрастания времени,
+     * и хранятся блоками по BLOCK_SIZE баров. Внутри блока метка времени
+     * хранится как разница с предыдущим баром, цены переводятся в пункты
+     * и хранятся как разницы: open относительно close предыдущего бара,
+     * close относительно open, high и low относительно тела бара.
+     * Все числа записываются кодом переменной длины, поэтому минутный бар
+     * обычно занимает 6-10 байт вместо sizeof(CANDLE).
+     * Последний прочитанный блок хранится в распакованном виде.
+     * Класс не потокобезопасен
+     * \tparam CANDLE Тип бара
+     */
+    template<class CANDLE>
+    class CandleArchive {
+    public:
+        static const size_t BLOCK_SIZE = 256;   /**< Количество баров в блоке */
+        static const size_t NONE = (size_t)-1;
+
+    private:
+        using price_type = decltype(CANDLE::close);
+        using volume_type = decltype(CANDLE::volume);
+
+        /** \brief Блок сжатых баров
+         */
+        class Block {
+        public:
+            std::vector<uint8_t> data;
+            xtime::timestamp_t first_timestamp = 0;
+            xtime::timestamp_t last_timestamp = 0;
+            int64_t last_close = 0;
+            size_t size = 0;
+        };
+
+        std::vector<Block> blocks;
+        size_t archive_size = 0;
+        uint32_t precision = 0;
+
+        /* распакованный блок */
+        mutable std::vector<CANDLE> cache;
+        mutable size_t cache_block = NONE;
+
+        static inline int64_t to_points(const double value, const uint32_t user_precision) {
+            int64_t points = 0;
+            common::set_candle_price(points, value, user_precision);
+            return points;
+        }
+
+        static inline int64_t to_points(const int64_t value, const uint32_t /*user_precision*/) {
+            return value;
+        }
+
+        static inline void from_points(double &value, const int64_t points, const uint32_t user_precision) {
+            value = common::get_candle_price(points, user_precision);
+        }
+
+        static inline void from_points(int64_t &value, const int64_t points, const uint32_t /*user_precision*/) {
+            value = points;
+        }
+
+        static inline void put_varint(std::vector<uint8_t> &data, uint64_t value) {
+            while(value >= 0x80) {
+                data.push_back((uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            data.push_back((uint8_t)value);
+        }
+
+        static inline uint64_t get_varint(const uint8_t *&data) {
+            uint64_t value = 0;
+            uint32_t shift = 0;
+            while(*data & 0x80) {
+                value |= (uint64_t)(*data++ & 0x7F) << shift;
+                shift += 7;
+            }
+            value |= (uint64_t)(*data++) << shift;
+            return value;
+        }
+
+        static inline uint64_t zigzag(const int64_t value) {
+            return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+        }
+
+        static inline int64_t unzigzag(const uint64_t value) {
+            return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        }
+
+        /** \brief Записать объем
+         *
+         * Целый объем записывается кодом переменной длины,
+         * дробный - восемью байтами без потерь
+         */
+        static inline void put_volume(std::vector<uint8_t> &data, const double volume) {
+            const double limit = 4503599627370496.0; // 2^52
+            if(volume == std::floor(volume) && std::fabs(volume) < limit) {
+                put_varint(data, zigzag((int64_t)volume) << 1);
+                return;
+            }
+            put_varint(data, 1);
+            uint8_t bytes[sizeof(double)];
+            std::memcpy(bytes, &volume, sizeof(double));
+            data.insert(data.end(), bytes, bytes + sizeof(double));
+        }
+
+        static inline void put_volume(std::vector<uint8_t> &data, const int64_t volume) {
+            put_varint(data, zigzag(volume));
+        }
+
+        static inline void get_volume(const uint8_t *&data, double &volume) {
+            const uint64_t value = get_varint(data);
+            if((value & 1) == 0) {
+                volume = (double)unzigzag(value >> 1);
+                return;
+            }
+            std::memcpy(&volume, data, sizeof(double));
+            data += sizeof(double);
+        }
+
+        static inline void get_volume(const uint8_t *&data, int64_t &volume) {
+            volume = unzigzag(get_varint(data));
+        }
+
+        /** \brief Распаковать блок в кэш
+         */
+        void decode_block(const size_t block_index) const {
+            if(cache_block == block_index) return;
+            const Block &block = blocks[block_index];
+            cache.resize(block.size);
+            const uint8_t *data = block.data.data();
+            xtime::timestamp_t timestamp = 0;
+            int64_t close = 0;
+            for(size_t i = 0; i < block.size; ++i) {
+                timestamp += get_varint(data);
+                const int64_t open = close + unzigzag(get_varint(data));
+                close = open + unzigzag(get_varint(data));
+                const int64_t high = std::max(open, close) + unzigzag(get_varint(data));
+                const int64_t low = std::min(open, close) - unzigzag(get_varint(data));
+                CANDLE &candle = cache[i];
+                from_points(candle.open, open, precision);
+                from_points(candle.high, high, precision);
+                from_points(candle.low, low, precision);
+                from_points(candle.close, close, precision);
+                get_volume(data, candle.volume);
+                candle.timestamp = timestamp;
+            }
+            cache_block = block_index;
+        }
+
+        /** \brief Найти блок, который может содержать метку времени
+         * \return Индекс блока или NONE, если метка времени раньше всех баров
+         */
+        size_t find_block(const xtime::timestamp_t timestamp) const {
+            size_t low = 0;
+            size_t high = blocks.size();
+            while(low < high) {
+                const size_t middle = low + (high - low) / 2;
+                if(blocks[middle].first_timestamp <= timestamp) low = middle + 1;
+                else high = middle;
+            }
+            return low == 0 ? NONE : low - 1;
+        }
+
+    public:
+
+        CandleArchive() {};
+
+        /** \brief Установить точность цен
+         *
+         * Цены баров common::Candle округляются до этой точности
+         * \param user_precision Количество знаков после запятой
+         */
+        inline void set_precision(const uint32_t user_precision) {
+            precision = user_precision;
+        }
+
+        inline size_t size() const {
+            return archive_size;
+        }
+
+        inline bool empty() const {
+            return archive_size == 0;
+        }
+
+        /** \brief Получить метку времени последнего бара
+         */
+        inline xtime::timestamp_t get_last_timestamp() const {
+            return blocks.empty() ? 0 : blocks.back().last_timestamp;
+        }
+
+        /** \brief Добавить бар в конец
+         * \param candle Бар, метка времени должна быть больше, чем у последнего бара
+         * \return Вернет false, если бар не новее последнего бара
+         */
+        bool push_back(const CANDLE &candle) {
+            if(!blocks.empty() && candle.timestamp <= blocks.back().last_timestamp) return false;
+            if(blocks.empty() || blocks.back().size >= BLOCK_SIZE) {
+                if(!blocks.empty()) blocks.back().data.shrink_to_fit();
+                blocks.emplace_back();
+                blocks.back().first_timestamp = candle.timestamp;
+            }
+            Block &block = blocks.back();
+            const int64_t open = to_points(candle.open, precision);
+            const int64_t high = to_points(candle.high, precision);
+            const int64_t low = to_points(candle.low, precision);
+            const int64_t close = to_points(candle.close, precision);
+            const xtime::timestamp_t prev_timestamp = block.size == 0 ? 0 : block.last_timestamp;
+            const int64_t prev_close = block.size == 0 ? 0 : block.last_close;
+            put_varint(block.data, candle.timestamp - prev_timestamp);
+            put_varint(block.data, zigzag(open - prev_close));
+            put_varint(block.data, zigzag(close - open));
+            put_varint(block.data, zigzag(high - std::max(open, close)));
+            put_varint(block.data, zigzag(std::min(open, close) - low));
+            put_volume(block.data, candle.volume);
+            block.last_timestamp = candle.timestamp;
+            block.last_close = close;
+            ++block.size;
+            ++archive_size;
+            if(cache_block == blocks.size() - 1) cache_block = NONE;
+            return true;
+        }
+
+        /** \brief Получить бар по индексу, 0 - самый старый бар
+         */
+        inline CANDLE get(const size_t index) const {
+            decode_block(index / BLOCK_SIZE);
+            return cache[index % BLOCK_SIZE];
+        }
+
+        /** \brief Найти индекс первого бара с меткой времени не меньше заданной
+         * \param timestamp Метка времени
+         * \return Индекс бара или size(), если таких баров нет
+         */
+        size_t lower_bound(const xtime::timestamp_t timestamp) const {
+            if(archive_size == 0 || timestamp > blocks.back().last_timestamp) return archive_size;
+            const size_t block_index = find_block(timestamp);
+            if(block_index == NONE) return 0;
+            if(timestamp > blocks[block_index].last_timestamp) return (block_index + 1) * BLOCK_SIZE;
+            decode_block(block_index);
+            size_t index = 0;
+            while(cache[index].timestamp < timestamp) ++index;
+            return block_index * BLOCK_SIZE + index;
+        }
+
+        /** \brief Найти индекс бара по метке времени
+         * \param timestamp Метка времени
+         * \return Индекс бара или NONE
+         */
+        size_t find(const xtime::timestamp_t timestamp) const {
+            const size_t index = lower_bound(timestamp);
+            if(index >= archive_size) return NONE;
+            if(get(index).timestamp != timestamp) return NONE;
+            return index;
+        }
+
+        /** \brief Скопировать диапазон баров
+         * \param index Индекс первого бара
+         * \param length Количество баров
+         * \param output Массив для баров
+         * \return Количество скопированных баров
+         */
+        size_t copy(size_t index, const size_t length, CANDLE *output) const {
+            if(index >= archive_size) return 0;
+            const size_t total = std::min(length, archive_size - index);
+            size_t n = 0;
+            while(n < total) {
+                const size_t block_index = index / BLOCK_SIZE;
+                decode_block(block_index);
+                const size_t offset = index % BLOCK_SIZE;
+                const size_t part = std::min(total - n, cache.size() - offset);
+                std::copy(cache.begin() + offset, cache.begin() + offset + part, output + n);
+                n += part;
+                index += part;
+            }
+            return total;
+        }
+
+        /** \brief Получить объем памяти, занятый сжатыми барами и кэшем
+         */
+        size_t get_memory_usage() const {
+            size_t bytes = blocks.capacity() * sizeof(Block) + cache.capacity() * sizeof(CANDLE);
+            for(const Block &block : blocks) {
+                bytes += block.data.capacity();
+            }
+            return bytes;
+        }
+
+        inline void clear() {
+            blocks.clear();
+            archive_size = 0;
+            cache_block = NONE;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_ARCHIVE_HPP_INCLUDED
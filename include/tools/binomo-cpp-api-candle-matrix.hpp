@@ -0,0 +1,194 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_MATRIX_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_MATRIX_HPP_INCLUDED
+
+#include <xtime.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace binomo_api {
+
+    /** \brief Матрица баров нескольких символов, выровненная по времени
+     *
+     * Данные хранятся по столбцам: для каждого символа цены open, high, low, close
+     * и объем лежат непрерывными массивами из rows() элементов,
+     * строка соответствует метке времени бара. Память переиспользуется
+     * между заполнениями, если размер матрицы не растет
+     * \tparam CANDLE Тип бара
+     */
+    template<class CANDLE>
+    class CandleMatrix {
+    public:
+        using price_type = decltype(CANDLE::close);
+        using volume_type = decltype(CANDLE::volume);
+
+        /** \brief Заполнение пропущенных баров
+         */
+        enum FillMode {
+            FILL_NONE = 0,      /**< Пропущенные бары заполняются нулями */
+            FILL_FORWARD = 1,   /**< Пропущенные бары заполняются ценой закрытия предыдущего бара и нулевым объемом */
+        };
+
+    private:
+        std::vector<price_type> open;
+        std::vector<price_type> high;
+        std::vector<price_type> low;
+        std::vector<price_type> close;
+        std::vector<volume_type> volume;
+        std::vector<uint8_t> present;       /**< 1 - бар есть в данных, 0 - бар пропущен */
+        std::vector<uint32_t> symbol_ids;
+        size_t num_rows = 0;
+        uint32_t period = 0;
+        xtime::timestamp_t first_timestamp = 0;
+
+    public:
+
+        CandleMatrix() {};
+
+        /** \brief Подготовить матрицу
+         *
+         * Используется потоком котировок перед заполнением
+         * \param user_symbol_ids Идентификаторы символов, по одному на столбец
+         * \param user_period Период
+         * \param user_first_timestamp Метка времени первой строки
+         * \param rows Количество строк
+         */
+        void reset(
+                const std::vector<uint32_t> &user_symbol_ids,
+                const uint32_t user_period,
+                const xtime::timestamp_t user_first_timestamp,
+                const size_t rows) {
+            symbol_ids.assign(user_symbol_ids.begin(), user_symbol_ids.end());
+            period = user_period;
+            first_timestamp = user_first_timestamp;
+            num_rows = rows;
+            const size_t size = rows * symbol_ids.size();
+            open.assign(size, price_type());
+            high.assign(size, price_type());
+            low.assign(size, price_type());
+            close.assign(size, price_type());
+            volume.assign(size, volume_type());
+            present.assign(size, 0);
+        }
+
+        /** \brief Записать бар в ячейку матрицы
+         */
+        inline void set(const size_t row, const size_t column, const CANDLE &candle, const bool is_present) {
+            const size_t index = column * num_rows + row;
+            open[index] = candle.open;
+            high[index] = candle.high;
+            low[index] = candle.low;
+            close[index] = candle.close;
+            volume[index] = candle.volume;
+            present[index] = is_present ? 1 : 0;
+        }
+
+        /** \brief Записать пропущенный бар, заполненный ценой закрытия
+         */
+        inline void set_fill(const size_t row, const size_t column, const price_type price) {
+            const size_t index = column * num_rows + row;
+            open[index] = price;
+            high[index] = price;
+            low[index] = price;
+            close[index] = price;
+            volume[index] = volume_type();
+            present[index] = 0;
+        }
+
+        inline size_t rows() const {
+            return num_rows;
+        }
+
+        inline size_t columns() const {
+            return symbol_ids.size();
+        }
+
+        inline uint32_t get_period() const {
+            return period;
+        }
+
+        /** \brief Получить идентификатор символа столбца
+         */
+        inline uint32_t get_symbol_id(const size_t column) const {
+            return symbol_ids[column];
+        }
+
+        /** \brief Получить метку времени строки
+         */
+        inline xtime::timestamp_t get_timestamp(const size_t row) const {
+            return first_timestamp + (xtime::timestamp_t)row * period;
+        }
+
+        /** \brief Получить столбец цен open символа, rows() элементов
+         */
+        inline const price_type *get_open(const size_t column) const {
+            return open.data() + column * num_rows;
+        }
+
+        inline const price_type *get_high(const size_t column) const {
+            return high.data() + column * num_rows;
+        }
+
+        inline const price_type *get_low(const size_t column) const {
+            return low.data() + column * num_rows;
+        }
+
+        inline const price_type *get_close(const size_t column) const {
+            return close.data() + column * num_rows;
+        }
+
+        inline const volume_type *get_volume(const size_t column) const {
+            return volume.data() + column * num_rows;
+        }
+
+        /** \brief Получить столбец признаков наличия баров, 1 - бар есть, 0 - пропущен
+         */
+        inline const uint8_t *get_present(const size_t column) const {
+            return present.data() + column * num_rows;
+        }
+
+        /** \brief Получить бар из ячейки матрицы
+         */
+        inline CANDLE get_candle(const size_t row, const size_t column) const {
+            const size_t index = column * num_rows + row;
+            CANDLE candle;
+            candle.open = open[index];
+            candle.high = high[index];
+            candle.low = low[index];
+            candle.close = close[index];
+            candle.volume = volume[index];
+            candle.timestamp = get_timestamp(row);
+            return candle;
+        }
+
+        /** \brief Проверить наличие бара в ячейке матрицы
+         */
+        inline bool is_present(const size_t row, const size_t column) const {
+            return present[column * num_rows + row] != 0;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_MATRIX_HPP_INCLUDED
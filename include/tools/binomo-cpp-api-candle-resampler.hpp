@@ -0,0 +1,197 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_RESAMPLER_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_RESAMPLER_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <vector>
+#include <future>
+#include <thread>
+#include <algorithm>
+
+namespace binomo_api {
+
+    /** \brief Преобразование баров в бары кратного периода
+     *
+     * Из баров одного периода собираются бары периода period * multiple,
+     * например 2m, 3m, 10m или 4h из минутных баров.
+     * Метка времени бара - время его окончания, как и в потоке котировок:
+     * бар с меткой времени T попадает в бар старшего периода,
+     * который заканчивается не раньше T (см. fold_candle в BinomoApiPriceStream).
+     * Длинные массивы делятся на части по границам баров старшего периода
+     * и обрабатываются в нескольких потоках
+     */
+    template<class CANDLE = common::Candle>
+    class CandleResampler {
+    public:
+        static const size_t MIN_PARALLEL_SIZE = 65536;  /**< Минимальное количество баров на поток */
+
+    private:
+
+        static inline xtime::timestamp_t get_bar_timestamp(const xtime::timestamp_t timestamp, const uint32_t period) {
+            const xtime::timestamp_t t = timestamp - 1;
+            return (t - (t % period)) + period;
+        }
+
+        /** \brief Оценить сверху количество баров результата для части массива
+         */
+        static inline size_t get_max_size(
+                const CANDLE *candles,
+                const size_t first,
+                const size_t last,
+                const uint32_t period) {
+            if(first >= last) return 0;
+            const xtime::timestamp_t first_timestamp = get_bar_timestamp(candles[first].timestamp, period);
+            const xtime::timestamp_t last_timestamp = get_bar_timestamp(candles[last - 1].timestamp, period);
+            if(last_timestamp < first_timestamp) return last - first;
+            return std::min((size_t)((last_timestamp - first_timestamp) / period) + 1, last - first);
+        }
+
+        /** \brief Собрать бары части массива
+         * \param candles Исходные бары
+         * \param first Индекс первого бара части
+         * \param last Индекс после последнего бара части
+         * \param period Период баров результата
+         * \param output Место под бары результата части, не меньше get_max_size()
+         * \param max_size Размер места под бары результата
+         * \return Количество баров результата или NONE, если бары не упорядочены по времени
+         */
+        static size_t resample_range(
+                const CANDLE *candles,
+                const size_t first,
+                const size_t last,
+                const uint32_t period,
+                CANDLE *output,
+                const size_t max_size) {
+            if(first >= last) return 0;
+            size_t size = 0;
+            CANDLE candle = candles[first];
+            candle.timestamp = get_bar_timestamp(candles[first].timestamp, period);
+            for(size_t i = first + 1; i < last; ++i) {
+                const CANDLE &next = candles[i];
+                if(next.timestamp <= candles[i - 1].timestamp) return NONE;
+                if(next.timestamp > candle.timestamp) {
+                    /* бар результата закончился */
+                    if(size == max_size) return NONE;
+                    output[size++] = candle;
+                    candle = next;
+                    candle.timestamp = get_bar_timestamp(next.timestamp, period);
+                    continue;
+                }
+                /* минимум и максимум без ветвлений */
+                candle.high = std::max(candle.high, next.high);
+                candle.low = std::min(candle.low, next.low);
+                candle.close = next.close;
+                candle.volume += next.volume;
+            }
+            if(size == max_size) return NONE;
+            output[size++] = candle;
+            return size;
+        }
+
+    public:
+        static const size_t NONE = (size_t)-1;
+
+        /** \brief Собрать бары кратного периода
+         * \param candles Бары, упорядоченные по времени без повторов
+         * \param period Период исходных баров
+         * \param multiple Во сколько раз период результата больше исходного
+         * \param output Бары периода period * multiple
+         * \param max_threads Максимальное количество потоков, 0 - по числу ядер
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        static int resample(
+                const std::vector<CANDLE> &candles,
+                const uint32_t period,
+                const uint32_t multiple,
+                std::vector<CANDLE> &output,
+                size_t max_threads = 0) {
+            output.clear();
+            if(period == 0 || multiple == 0) return common::INVALID_PARAMETER;
+            const uint32_t resample_period = period * multiple;
+            const size_t size = candles.size();
+            if(size == 0) return common::OK;
+
+            if(max_threads == 0) max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+            const size_t num_threads = std::max(std::min(max_threads, size / MIN_PARALLEL_SIZE), (size_t)1);
+
+            /* границы частей сдвигаем так, чтобы бар результата не делился между частями */
+            std::vector<size_t> bounds(num_threads + 1, size);
+            bounds[0] = 0;
+            for(size_t n = 1; n < num_threads; ++n) {
+                size_t index = std::max(size * n / num_threads, bounds[n - 1]);
+                while(index > 0 && index < size &&
+                    get_bar_timestamp(candles[index].timestamp, resample_period) ==
+                    get_bar_timestamp(candles[index - 1].timestamp, resample_period)) {
+                    ++index;
+                }
+                bounds[n] = index;
+            }
+
+            /* место под результат каждой части оцениваем по меткам времени ее крайних баров */
+            std::vector<size_t> offsets(num_threads + 1, 0);
+            for(size_t n = 0; n < num_threads; ++n) {
+                offsets[n + 1] = offsets[n] + get_max_size(candles.data(), bounds[n], bounds[n + 1], resample_period);
+            }
+            output.resize(offsets[num_threads]);
+
+            std::vector<size_t> sizes(num_threads, 0);
+            auto resample_part = [&](const size_t n) {
+                sizes[n] = resample_range(
+                    candles.data(), bounds[n], bounds[n + 1], resample_period,
+                    output.data() + offsets[n], offsets[n + 1] - offsets[n]);
+            };
+            std::vector<std::future<void>> tasks;
+            for(size_t n = 1; n < num_threads; ++n) {
+                tasks.push_back(std::async(std::launch::async, resample_part, n));
+            }
+            resample_part(0);
+            for(auto &task : tasks) {
+                task.wait();
+            }
+
+            /* проверяем порядок на стыках частей и сдвигаем результаты частей к началу */
+            size_t output_size = 0;
+            for(size_t n = 0; n < num_threads; ++n) {
+                if(sizes[n] == NONE) {
+                    output.clear();
+                    return common::INVALID_PARAMETER;
+                }
+                const size_t first = bounds[n];
+                if(first > 0 && first < size && candles[first].timestamp <= candles[first - 1].timestamp) {
+                    output.clear();
+                    return common::INVALID_PARAMETER;
+                }
+                if(output_size != offsets[n]) {
+                    std::copy(output.begin() + offsets[n], output.begin() + offsets[n] + sizes[n], output.begin() + output_size);
+                }
+                output_size += sizes[n];
+            }
+            output.resize(output_size);
+            return common::OK;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_RESAMPLER_HPP_INCLUDED
@@ -0,0 +1,477 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_RING_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_RING_HPP_INCLUDED
+
+#include <xtime.hpp>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+namespace binomo_api {
+
+    /** \brief Кольцевой буфер баров одного символа и периода
+     *
+     * Бары лежат в непрерывном массиве, выровненном по строке кэша,
+     * и упорядочены по метке времени. Последний бар и бар по смещению
+     * от последнего доступны за O(1). Бар по метке времени ищется
+     * по номеру периода от последнего бара, а если в данных есть пропуски,
+     * то двоичным поиском по оставшейся части буфера.
+     * Буфер растет удвоением. Если задано максимальное количество баров,
+     * то при его достижении самый старый бар вытесняется за O(1).
+     */
+    template<class CANDLE>
+    class CandleRing {
+    public:
+        static const size_t NONE = (size_t)-1;  /**< Индекс отсутствующего бара */
+        static const size_t CACHE_LINE = 64;    /**< Размер строки кэша */
+
+    private:
+        CANDLE *buffer = nullptr;
+        size_t buffer_capacity = 0;             /**< Емкость, степень двойки */
+        size_t head = 0;                        /**< Индекс самого старого бара в массиве */
+        size_t count = 0;                       /**< Количество баров */
+        size_t max_size = 0;                    /**< Максимальное количество баров, 0 - без ограничений */
+        uint32_t period = 0;
+        uint32_t tier_period = 0;               /**< Период, в который сворачиваются вытесненные бары, 0 - не сворачивать */
+        bool is_compressed = false;             /**< Флаг сжатия вытесненных баров */
+        xtime::timestamp_t fold_timestamp = 0;  /**< Метка времени бара, который собирается из свернутых баров */
+        uint64_t front_sequence = 0;            /**< Сколько баров всего удалено из начала */
+        uint64_t layout_version = 0;            /**< Версия расположения баров, меняется при изменении уже сохраненных баров */
+        uint64_t update_count = 0;              /**< Счетчик обновлений баров */
+
+        /** \brief Выделить память, выровненную по линии кэша
+         *
+         * Память выделяется с запасом, а адрес исходного блока хранится
+         * перед выровненным адресом, поэтому не нужен aligned new
+         */
+        static void *allocate_aligned(const size_t size) {
+            char *raw = static_cast<char*>(::operator new(size + CACHE_LINE + sizeof(void*)));
+            const uintptr_t address = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+            void **aligned = reinterpret_cast<void**>((address + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+            aligned[-1] = raw;
+            return aligned;
+        }
+
+        static void free_aligned(void *data) {
+            ::operator delete(static_cast<void**>(data)[-1]);
+        }
+
+        static CANDLE *allocate(const size_t capacity) {
+            CANDLE *data = static_cast<CANDLE*>(allocate_aligned(sizeof(CANDLE) * capacity));
+            for(size_t i = 0; i < capacity; ++i) {
+                new (data + i) CANDLE();
+            }
+            return data;
+        }
+
+        static void deallocate(CANDLE *data, const size_t capacity) {
+            if(!data) return;
+            for(size_t i = 0; i < capacity; ++i) {
+                data[i].~CANDLE();
+            }
+            free_aligned(data);
+        }
+
+        inline size_t get_position(const size_t index) const {
+            return (head + index) & (buffer_capacity - 1);
+        }
+
+        void reallocate(const size_t new_capacity) {
+            CANDLE *new_buffer = allocate(new_capacity);
+            for(size_t i = 0; i < count; ++i) {
+                new_buffer[i] = buffer[get_position(i)];
+            }
+            deallocate(buffer, buffer_capacity);
+            buffer = new_buffer;
+            buffer_capacity = new_capacity;
+            head = 0;
+        }
+
+        void reserve_more() {
+            size_t new_capacity = buffer_capacity == 0 ? 64 : buffer_capacity * 2;
+            /* не выделяем больше, чем нужно для max_size */
+            if(max_size != 0) {
+                size_t max_capacity = 1;
+                while(max_capacity < max_size) max_capacity *= 2;
+                if(new_capacity > max_capacity && max_capacity > buffer_capacity) {
+                    new_capacity = max_capacity;
+                }
+            }
+            reallocate(new_capacity);
+        }
+
+        /** \brief Двоичный поиск первого бара с меткой времени не меньше заданной
+         */
+        size_t lower_bound(size_t first, size_t last, const xtime::timestamp_t timestamp) const {
+            while(first < last) {
+                const size_t middle = first + (last - first) / 2;
+                if((*this)[middle].timestamp < timestamp) first = middle + 1;
+                else last = middle;
+            }
+            return first;
+        }
+
+    public:
+
+        CandleRing(const uint32_t user_period = 0) : period(user_period) {};
+
+        CandleRing(const CandleRing&) = delete;
+        CandleRing &operator=(const CandleRing&) = delete;
+
+        CandleRing(CandleRing &&other) noexcept {
+            *this = std::move(other);
+        }
+
+        CandleRing &operator=(CandleRing &&other) noexcept {
+            if(this == &other) return *this;
+            deallocate(buffer, buffer_capacity);
+            buffer = other.buffer;
+            buffer_capacity = other.buffer_capacity;
+            head = other.head;
+            count = other.count;
+            max_size = other.max_size;
+            period = other.period;
+            tier_period = other.tier_period;
+            is_compressed = other.is_compressed;
+            fold_timestamp = other.fold_timestamp;
+            front_sequence = other.front_sequence;
+            layout_version = other.layout_version;
+            update_count = other.update_count;
+            other.buffer = nullptr;
+            other.buffer_capacity = 0;
+            other.head = 0;
+            other.count = 0;
+            return *this;
+        }
+
+        ~CandleRing() {
+            deallocate(buffer, buffer_capacity);
+        }
+
+        inline size_t size() const {
+            return count;
+        }
+
+        inline bool empty() const {
+            return count == 0;
+        }
+
+        inline size_t capacity() const {
+            return buffer_capacity;
+        }
+
+        inline uint32_t get_period() const {
+            return period;
+        }
+
+        inline void set_period(const uint32_t user_period) {
+            period = user_period;
+        }
+
+        /** \brief Получить объем памяти, занятый барами
+         * \return Размер выделенного массива в байтах
+         */
+        inline size_t get_memory_usage() const {
+            return buffer_capacity * sizeof(CANDLE);
+        }
+
+        /** \brief Установить максимальное количество баров
+         *
+         * Уже сохраненные бары не удаляются, лишние бары
+         * можно проверить через excess() и удалить через pop_front()
+         * \param user_max_size Максимальное количество баров, 0 - без ограничений
+         */
+        inline void set_max_size(const size_t user_max_size) {
+            max_size = user_max_size;
+        }
+
+        inline size_t get_max_size() const {
+            return max_size;
+        }
+
+        /** \brief Заранее выделить место под бары
+         *
+         * Нужно для коротких периодов, где новый бар появляется каждые несколько секунд:
+         * после резервирования добавление бара не выделяет память
+         * \param capacity Количество баров
+         */
+        void reserve(const size_t capacity) {
+            if(capacity <= buffer_capacity) return;
+            size_t new_capacity = 64;
+            while(new_capacity < capacity) new_capacity *= 2;
+            reallocate(new_capacity);
+        }
+
+        /** \brief Проверить, заполнен ли буфер до максимального количества баров
+         */
+        inline bool full() const {
+            return max_size != 0 && count >= max_size;
+        }
+
+        /** \brief Проверить, превышено ли максимальное количество баров
+         */
+        inline bool excess() const {
+            return max_size != 0 && count > max_size;
+        }
+
+        inline void set_tier_period(const uint32_t user_tier_period) {
+            tier_period = user_tier_period;
+        }
+
+        inline uint32_t get_tier_period() const {
+            return tier_period;
+        }
+
+        inline void set_compressed(const bool value) {
+            is_compressed = value;
+        }
+
+        inline bool get_compressed() const {
+            return is_compressed;
+        }
+
+        inline void set_fold_timestamp(const xtime::timestamp_t timestamp) {
+            fold_timestamp = timestamp;
+        }
+
+        inline xtime::timestamp_t get_fold_timestamp() const {
+            return fold_timestamp;
+        }
+
+        /** \brief Получить бар по индексу, 0 - самый старый бар
+         */
+        inline CANDLE &operator[](const size_t index) {
+            return buffer[get_position(index)];
+        }
+
+        inline const CANDLE &operator[](const size_t index) const {
+            return buffer[get_position(index)];
+        }
+
+        /** \brief Получить самый старый бар
+         */
+        inline const CANDLE &front() const {
+            return buffer[head];
+        }
+
+        /** \brief Удалить самый старый бар
+         */
+        inline void pop_front() {
+            if(count == 0) return;
+            head = (head + 1) & (buffer_capacity - 1);
+            --count;
+            ++front_sequence;
+        }
+
+        /** \brief Получить последний бар
+         */
+        inline CANDLE &back() {
+            return buffer[get_position(count - 1)];
+        }
+
+        inline const CANDLE &back() const {
+            return buffer[get_position(count - 1)];
+        }
+
+        /** \brief Получить бар по смещению от последнего, 0 - последний бар
+         */
+        inline const CANDLE &from_back(const size_t offset) const {
+            return buffer[get_position(count - 1 - offset)];
+        }
+
+        /** \brief Скопировать диапазон баров
+         *
+         * Диапазон копируется не более чем двумя непрерывными участками буфера
+         * \param index Индекс первого бара, 0 - самый старый бар
+         * \param length Количество баров
+         * \param output Массив для баров, в порядке от старых к новым
+         * \return Количество скопированных баров
+         */
+        size_t copy(const size_t index, const size_t length, CANDLE *output) const {
+            if(index >= count) return 0;
+            const size_t total = std::min(length, count - index);
+            const size_t position = get_position(index);
+            const size_t first_part = std::min(total, buffer_capacity - position);
+            std::copy(buffer + position, buffer + position + first_part, output);
+            std::copy(buffer, buffer + (total - first_part), output + first_part);
+            return total;
+        }
+
+        /** \brief Найти индекс бара по метке времени
+         * \param timestamp Метка времени бара
+         * \return Индекс бара или NONE
+         */
+        size_t find(const xtime::timestamp_t timestamp) const {
+            if(count == 0) return NONE;
+            const xtime::timestamp_t last_timestamp = back().timestamp;
+            if(timestamp > last_timestamp) return NONE;
+            size_t first = 0;
+            size_t last = count;
+            if(period != 0) {
+                /* без пропусков бар находится на известном расстоянии от последнего */
+                const xtime::timestamp_t steps = (last_timestamp - timestamp) / period;
+                if(steps < count) {
+                    const size_t index = count - 1 - (size_t)steps;
+                    const xtime::timestamp_t index_timestamp = (*this)[index].timestamp;
+                    if(index_timestamp == timestamp) return index;
+                    if(index_timestamp < timestamp) first = index + 1;
+                    else last = index;
+                }
+            }
+            const size_t index = lower_bound(first, last, timestamp);
+            if(index < count && (*this)[index].timestamp == timestamp) return index;
+            return NONE;
+        }
+
+        /** \brief Найти индекс первого бара с меткой времени не меньше заданной
+         * \param timestamp Метка времени
+         * \return Индекс бара или size(), если таких баров нет
+         */
+        inline size_t lower_bound(const xtime::timestamp_t timestamp) const {
+            const size_t index = find(timestamp);
+            if(index != NONE) return index;
+            return lower_bound(0, count, timestamp);
+        }
+
+        /** \brief Добавить бар в конец
+         *
+         * Метка времени бара должна быть больше метки времени последнего бара
+         */
+        void push_back(const CANDLE &candle) {
+            if(full()) pop_front();
+            if(count == buffer_capacity) reserve_more();
+            buffer[get_position(count)] = candle;
+            ++count;
+        }
+
+        /** \brief Вставить бар с сохранением порядка
+         *
+         * Если бар с такой меткой времени уже есть, он не изменяется.
+         * Вставка в середину сдвигает более новые бары
+         * \param candle Бар
+         * \return Индекс бара или NONE, если бар старше всех баров заполненного буфера
+         */
+        size_t insert(const CANDLE &candle) {
+            if(count == 0 || candle.timestamp > back().timestamp) {
+                push_back(candle);
+                return count - 1;
+            }
+            size_t index = lower_bound(candle.timestamp);
+            if(index < count && (*this)[index].timestamp == candle.timestamp) return index;
+            if(full()) {
+                /* бар старше всех хранимых баров не помещается */
+                if(index == 0) return NONE;
+                pop_front();
+                --index;
+            }
+            if(count == buffer_capacity) reserve_more();
+            for(size_t i = count; i > index; --i) {
+                (*this)[i] = (*this)[i - 1];
+            }
+            (*this)[index] = candle;
+            ++count;
+            ++layout_version;
+            return index;
+        }
+
+        /** \brief Добавить массив баров
+         *
+         * Бары с метками времени, которые уже есть в буфере, пропускаются.
+         * После слияния баров может стать больше максимального количества
+         * \param candles Массив баров в любом порядке
+         */
+        template<class T>
+        void merge(const T &candles) {
+            std::vector<CANDLE> merged;
+            merged.reserve(count + candles.size());
+            for(size_t i = 0; i < count; ++i) {
+                merged.push_back((*this)[i]);
+            }
+            for(const CANDLE &candle : candles) {
+                merged.push_back(candle);
+            }
+            /* стабильная сортировка оставляет существующие бары впереди новых */
+            std::stable_sort(merged.begin(), merged.end(), [](const CANDLE &a, const CANDLE &b) {
+                return a.timestamp < b.timestamp;
+            });
+            clear();
+            /* ограничение размера здесь не применяется, см. excess() */
+            const size_t user_max_size = max_size;
+            max_size = 0;
+            for(const CANDLE &candle : merged) {
+                if(count > 0 && back().timestamp == candle.timestamp) continue;
+                push_back(candle);
+            }
+            max_size = user_max_size;
+        }
+
+        /** \brief Удалить все бары
+         */
+        inline void clear() {
+            head = 0;
+            count = 0;
+            ++layout_version;
+        }
+
+        /** \brief Отметить изменение бара
+         *
+         * Изменение последнего бара - обычное обновление по тику,
+         * изменение более старых баров меняет версию расположения
+         * \param index Индекс измененного бара
+         */
+        inline void mark_modified(const size_t index) {
+            ++update_count;
+            if(index + 1 < count) ++layout_version;
+        }
+
+        /** \brief Получить количество баров, удаленных из начала за все время
+         *
+         * Вместе с индексом дает сквозной номер бара: get_front_sequence() + index
+         */
+        inline uint64_t get_front_sequence() const {
+            return front_sequence;
+        }
+
+        /** \brief Получить версию расположения баров
+         *
+         * Версия не меняется при добавлении баров в конец, обновлении последнего бара
+         * и удалении баров из начала, поэтому сквозные номера баров остаются прежними
+         */
+        inline uint64_t get_layout_version() const {
+            return layout_version;
+        }
+
+        /** \brief Получить счетчик обновлений баров, отмеченных через mark_modified
+         */
+        inline uint64_t get_update_count() const {
+            return update_count;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_RING_HPP_INCLUDED
@@ -0,0 +1,372 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_SNAPSHOT_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_SNAPSHOT_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace binomo_api {
+
+    /** \brief Файл снимка хранилища баров
+     *
+     * Формат файла: сигнатура, тип цены и тип объема, затем серии баров
+     * (длина имени символа, имя, период, количество баров, бары)
+     * и серия с пустым именем в конце. Поля бара записываются по отдельности
+     * (метка времени, open, high, low, close, volume по 8 байт),
+     * поэтому формат не зависит от выравнивания структуры бара.
+     * Снимок сначала пишется во временный файл, который затем
+     * заменяет старый снимок одной операцией, поэтому при сбое остается прежний снимок
+     * \tparam CANDLE Тип бара
+     */
+    template<class CANDLE>
+    class CandleSnapshot {
+    private:
+        using price_type = decltype(CANDLE::close);
+        using volume_type = decltype(CANDLE::volume);
+
+        static constexpr const char *SIGNATURE = "BNMSNAP2";
+        static const size_t SIGNATURE_SIZE = 8;
+        static const size_t CANDLE_SIZE = 6 * 8;    /**< Размер бара в файле */
+
+        static_assert(sizeof(price_type) == 8 && sizeof(volume_type) == 8, "candle fields must be 8 bytes");
+
+        std::ofstream file;
+        std::string file_name;
+        std::string temp_file_name;
+        std::vector<char> buffer;
+
+        /** \brief Тип числа в файле: 0 - double, 1 - целое
+         */
+        template<class T>
+        static inline uint8_t get_type_code() {
+            return std::is_integral<T>::value ? 1 : 0;
+        }
+
+        template<class T>
+        static inline char *put_value(char *data, const T value) {
+            std::memcpy(data, &value, sizeof(value));
+            return data + sizeof(value);
+        }
+
+        template<class T>
+        static inline const char *get_value(const char *data, T &value) {
+            std::memcpy(&value, data, sizeof(value));
+            return data + sizeof(value);
+        }
+
+        /** \brief Заменить файл одной операцией
+         * \param from Имя нового файла
+         * \param to Имя заменяемого файла
+         * \return Вернет true в случае успеха
+         */
+        static bool replace_file(const std::string &from, const std::string &to) {
+#           if defined(_WIN32)
+            return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#           else
+            return std::rename(from.c_str(), to.c_str()) == 0;
+#           endif
+        }
+
+    public:
+
+        CandleSnapshot() {};
+
+        /** \brief Начать запись снимка
+         * \param user_file_name Имя файла снимка
+         * \return Вернет true в случае успеха
+         */
+        bool open(const std::string &user_file_name) {
+            file_name = user_file_name;
+            temp_file_name = user_file_name + ".tmp";
+            file = std::ofstream(temp_file_name, std::ios_base::binary | std::ios::out | std::ios::trunc);
+            if(!file.is_open()) return false;
+            const uint8_t price_code = get_type_code<price_type>();
+            const uint8_t volume_code = get_type_code<volume_type>();
+            file.write(SIGNATURE, SIGNATURE_SIZE);
+            file.write(reinterpret_cast<const char*>(&price_code), sizeof(price_code));
+            file.write(reinterpret_cast<const char*>(&volume_code), sizeof(volume_code));
+            return file.good();
+        }
+
+        /** \brief Записать серию баров
+         * \param symbol Имя символа
+         * \param period Период
+         * \param candles Указатель на бары, от старых к новым
+         * \param size Количество баров
+         */
+        void write(const std::string &symbol, const uint32_t period, const CANDLE *candles, const uint64_t size) {
+            const uint8_t symbol_size = (uint8_t)std::min(symbol.size(), (size_t)255);
+            file.write(reinterpret_cast<const char*>(&symbol_size), sizeof(symbol_size));
+            file.write(symbol.data(), symbol_size);
+            file.write(reinterpret_cast<const char*>(&period), sizeof(period));
+            file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            buffer.resize(size * CANDLE_SIZE);
+            char *data = buffer.data();
+            for(uint64_t i = 0; i < size; ++i) {
+                const CANDLE &candle = candles[i];
+                data = put_value(data, (uint64_t)candle.timestamp);
+                data = put_value(data, candle.open);
+                data = put_value(data, candle.high);
+                data = put_value(data, candle.low);
+                data = put_value(data, candle.close);
+                data = put_value(data, candle.volume);
+            }
+            file.write(buffer.data(), buffer.size());
+        }
+
+        /** \brief Завершить запись и заменить старый снимок
+         * \return Вернет true в случае успеха
+         */
+        bool close() {
+            const uint8_t end = 0;
+            file.write(reinterpret_cast<const char*>(&end), sizeof(end));
+            file.flush();
+            const bool is_good = file.good();
+            file.close();
+            if(!is_good || !replace_file(temp_file_name, file_name)) {
+                std::remove(temp_file_name.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        /** \brief Прочитать снимок
+         * \param file_name Имя файла снимка
+         * \param f Функция, которая получает имя символа, период и бары каждой серии
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        template<class F>
+        static int read(const std::string &file_name, F f) {
+            std::ifstream file(file_name, std::ios_base::binary);
+            if(!file.is_open()) return common::DATA_NOT_AVAILABLE;
+            char signature[SIGNATURE_SIZE];
+            uint8_t price_code = 0;
+            uint8_t volume_code = 0;
+            file.read(signature, SIGNATURE_SIZE);
+            file.read(reinterpret_cast<char*>(&price_code), sizeof(price_code));
+            file.read(reinterpret_cast<char*>(&volume_code), sizeof(volume_code));
+            if(!file.good() ||
+                std::memcmp(signature, SIGNATURE, SIGNATURE_SIZE) != 0 ||
+                price_code != get_type_code<price_type>() ||
+                volume_code != get_type_code<volume_type>()) return common::PARSER_ERROR;
+            std::vector<CANDLE> candles;
+            std::vector<char> data_buffer;
+            std::string symbol;
+            while(true) {
+                uint8_t symbol_size = 0;
+                file.read(reinterpret_cast<char*>(&symbol_size), sizeof(symbol_size));
+                if(!file.good()) return common::PARSER_ERROR;
+                if(symbol_size == 0) break;
+                symbol.resize(symbol_size);
+                uint32_t period = 0;
+                uint64_t size = 0;
+                file.read(&symbol[0], symbol_size);
+                file.read(reinterpret_cast<char*>(&period), sizeof(period));
+                file.read(reinterpret_cast<char*>(&size), sizeof(size));
+                if(!file.good()) return common::PARSER_ERROR;
+                data_buffer.resize(size * CANDLE_SIZE);
+                file.read(data_buffer.data(), data_buffer.size());
+                if(!file.good()) return common::PARSER_ERROR;
+                candles.resize(size);
+                const char *data = data_buffer.data();
+                for(CANDLE &candle : candles) {
+                    uint64_t timestamp = 0;
+                    price_type open = 0, high = 0, low = 0, close = 0;
+                    volume_type volume = 0;
+                    data = get_value(data, timestamp);
+                    data = get_value(data, open);
+                    data = get_value(data, high);
+                    data = get_value(data, low);
+                    data = get_value(data, close);
+                    data = get_value(data, volume);
+                    candle.timestamp = timestamp;
+                    candle.open = open;
+                    candle.high = high;
+                    candle.low = low;
+                    candle.close = close;
+                    candle.volume = volume;
+                }
+                f(symbol, period, candles);
+            }
+            return common::OK;
+        }
+    };
+
+    /** \brief Журнал тиков
+     *
+     * Хранит тики, обработанные после последнего снимка хранилища баров.
+     * Запись тика: длина имени символа, имя, цена, метка времени.
+     * Перед записью снимка журнал переходит в новый файл, а старые файлы
+     * (сегменты file_name.1, file_name.2, ...) удаляются только после того,
+     * как снимок записан. Неполная последняя запись при чтении пропускается
+     */
+    class TickJournal {
+    private:
+        std::ofstream file;
+        std::string file_name;
+        std::vector<char> buffer;
+        uint32_t num_segments = 0;  /**< Количество закрытых сегментов, еще не попавших в снимок */
+
+        static inline std::string get_segment_name(const std::string &file_name, const uint32_t index) {
+            return file_name + "." + std::to_string(index);
+        }
+
+        static inline bool check_file(const std::string &file_name) {
+            std::ifstream file(file_name, std::ios_base::binary);
+            return file.is_open();
+        }
+
+        /** \brief Прочитать один файл журнала
+         * \return Вернет false, если файла нет
+         */
+        template<class F>
+        static bool read_file(const std::string &file_name, F &f) {
+            std::ifstream file(file_name, std::ios_base::binary);
+            if(!file.is_open()) return false;
+            std::string symbol;
+            while(true) {
+                uint8_t symbol_size = 0;
+                double price = 0;
+                xtime::ftimestamp_t timestamp = 0;
+                file.read(reinterpret_cast<char*>(&symbol_size), sizeof(symbol_size));
+                if(!file.good()) break;
+                symbol.resize(symbol_size);
+                if(symbol_size != 0) file.read(&symbol[0], symbol_size);
+                file.read(reinterpret_cast<char*>(&price), sizeof(price));
+                file.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp));
+                if(!file.good()) break;
+                f(symbol, price, timestamp);
+            }
+            return true;
+        }
+
+    public:
+
+        TickJournal() {};
+
+        /** \brief Открыть журнал для дозаписи
+         *
+         * Сегменты, оставшиеся от прошлого запуска, сохраняются до следующего снимка
+         * \param user_file_name Имя файла журнала
+         * \return Вернет true в случае успеха
+         */
+        bool open(const std::string &user_file_name) {
+            file_name = user_file_name;
+            num_segments = 0;
+            while(check_file(get_segment_name(file_name, num_segments + 1))) ++num_segments;
+            file = std::ofstream(file_name, std::ios_base::binary | std::ios::out | std::ios::app);
+            return file.is_open();
+        }
+
+        inline bool is_open() const {
+            return file.is_open();
+        }
+
+        /** \brief Записать тик
+         * \param symbol Имя символа
+         * \param price Цена
+         * \param timestamp Метка времени тика
+         */
+        void write(const std::string &symbol, const double price, const xtime::ftimestamp_t timestamp) {
+            const uint8_t symbol_size = (uint8_t)std::min(symbol.size(), (size_t)255);
+            buffer.resize(sizeof(symbol_size) + symbol_size + sizeof(price) + sizeof(timestamp));
+            char *data = buffer.data();
+            std::memcpy(data, &symbol_size, sizeof(symbol_size));
+            data += sizeof(symbol_size);
+            std::memcpy(data, symbol.data(), symbol_size);
+            data += symbol_size;
+            std::memcpy(data, &price, sizeof(price));
+            data += sizeof(price);
+            std::memcpy(data, &timestamp, sizeof(timestamp));
+            file.write(buffer.data(), buffer.size());
+        }
+
+        inline void flush() {
+            file.flush();
+        }
+
+        /** \brief Закрыть текущий файл журнала как сегмент и начать новый файл
+         *
+         * Вызывается перед записью снимка: тики сегментов попадут в снимок,
+         * тики нового файла - нет
+         * \return Вернет true в случае успеха
+         */
+        bool rotate() {
+            if(!file.is_open()) return false;
+            file.close();
+            const std::string segment_name = get_segment_name(file_name, num_segments + 1);
+            if(std::rename(file_name.c_str(), segment_name.c_str()) != 0) {
+                file = std::ofstream(file_name, std::ios_base::binary | std::ios::out | std::ios::app);
+                return false;
+            }
+            ++num_segments;
+            file = std::ofstream(file_name, std::ios_base::binary | std::ios::out | std::ios::trunc);
+            return file.is_open();
+        }
+
+        /** \brief Удалить сегменты, тики которых уже сохранены в снимке
+         *
+         * Вызывается после записи снимка, между rotate() и этим методом
+         * другой снимок записываться не должен
+         */
+        void remove_segments() {
+            for(uint32_t index = 1; index <= num_segments; ++index) {
+                std::remove(get_segment_name(file_name, index).c_str());
+            }
+            num_segments = 0;
+        }
+
+        inline void close() {
+            if(file.is_open()) file.close();
+        }
+
+        /** \brief Прочитать журнал
+         *
+         * Сначала читаются сегменты по порядку, затем текущий файл журнала
+         * \param file_name Имя файла журнала
+         * \param f Функция, которая получает имя символа, цену и метку времени каждого тика
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        template<class F>
+        static int read(const std::string &file_name, F f) {
+            bool is_found = false;
+            for(uint32_t index = 1; read_file(get_segment_name(file_name, index), f); ++index) {
+                is_found = true;
+            }
+            if(read_file(file_name, f)) is_found = true;
+            return is_found ? common::OK : common::DATA_NOT_AVAILABLE;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_SNAPSHOT_HPP_INCLUDED
@@ -0,0 +1,259 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_VIEW_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_VIEW_HPP_INCLUDED
+
+#include "binomo-cpp-api-candle-ring.hpp"
+#include <memory>
+#include <vector>
+#include <iterator>
+
+namespace binomo_api {
+
+    /** \brief Неизменяемый снимок истории баров одного символа и периода
+     *
+     * Снимок состоит из блоков баров, которые разделяются между снимками.
+     * Блок никогда не изменяется после публикации, поэтому читать снимок
+     * можно из любого потока без блокировок. Память блока освобождается,
+     * когда его перестает использовать последний снимок
+     */
+    template<class CANDLE>
+    class CandleView {
+    public:
+        static const size_t CHUNK_SIZE = 256;           /**< Количество баров в блоке */
+        using chunk_t = std::vector<CANDLE>;
+        using chunk_ptr = std::shared_ptr<const chunk_t>;
+
+        /** \brief Итератор снимка
+         */
+        class const_iterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = CANDLE;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const CANDLE*;
+            using reference = const CANDLE&;
+
+            const_iterator(const CandleView *user_view = nullptr, const size_t user_index = 0) :
+                view(user_view), index(user_index) {};
+
+            inline reference operator*() const {return (*view)[index];}
+            inline pointer operator->() const {return &(*view)[index];}
+            inline reference operator[](const difference_type n) const {return (*view)[index + n];}
+            inline const_iterator &operator++() {++index; return *this;}
+            inline const_iterator operator++(int) {const_iterator temp = *this; ++index; return temp;}
+            inline const_iterator &operator--() {--index; return *this;}
+            inline const_iterator operator--(int) {const_iterator temp = *this; --index; return temp;}
+            inline const_iterator &operator+=(const difference_type n) {index += n; return *this;}
+            inline const_iterator &operator-=(const difference_type n) {index -= n; return *this;}
+            inline const_iterator operator+(const difference_type n) const {return const_iterator(view, index + n);}
+            inline const_iterator operator-(const difference_type n) const {return const_iterator(view, index - n);}
+            inline difference_type operator-(const const_iterator &other) const {
+                return (difference_type)index - (difference_type)other.index;
+            }
+            inline bool operator==(const const_iterator &other) const {return index == other.index;}
+            inline bool operator!=(const const_iterator &other) const {return index != other.index;}
+            inline bool operator<(const const_iterator &other) const {return index < other.index;}
+
+        private:
+            const CandleView *view;
+            size_t index;
+        };
+
+    private:
+        template<class T>
+        friend class CandleViewBuilder;
+
+        std::vector<chunk_ptr> chunks;
+        uint64_t chunk_base = 0;    /**< Сквозной номер первого бара первого блока */
+        uint64_t first = 0;         /**< Сквозной номер первого бара снимка */
+        size_t view_size = 0;
+        uint32_t period = 0;
+
+    public:
+
+        CandleView() {};
+
+        inline size_t size() const {
+            return view_size;
+        }
+
+        inline bool empty() const {
+            return view_size == 0;
+        }
+
+        inline uint32_t get_period() const {
+            return period;
+        }
+
+        /** \brief Получить бар по индексу, 0 - самый старый бар
+         */
+        inline const CANDLE &operator[](const size_t index) const {
+            const uint64_t position = first + index - chunk_base;
+            return (*chunks[position / CHUNK_SIZE])[position % CHUNK_SIZE];
+        }
+
+        /** \brief Получить последний бар
+         */
+        inline const CANDLE &back() const {
+            return (*this)[view_size - 1];
+        }
+
+        /** \brief Получить бар по смещению от последнего, 0 - последний бар
+         */
+        inline const CANDLE &from_back(const size_t offset) const {
+            return (*this)[view_size - 1 - offset];
+        }
+
+        inline const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+
+        inline const_iterator end() const {
+            return const_iterator(this, view_size);
+        }
+
+        /** \brief Найти индекс первого бара с меткой времени не меньше заданной
+         * \param timestamp Метка времени
+         * \return Индекс бара или size(), если таких баров нет
+         */
+        size_t lower_bound(const xtime::timestamp_t timestamp) const {
+            size_t low = 0;
+            size_t high = view_size;
+            while(low < high) {
+                const size_t middle = low + (high - low) / 2;
+                if((*this)[middle].timestamp < timestamp) low = middle + 1;
+                else high = middle;
+            }
+            return low;
+        }
+
+        /** \brief Найти индекс бара по метке времени
+         * \param timestamp Метка времени
+         * \return Индекс бара или CandleRing<CANDLE>::NONE
+         */
+        size_t find(const xtime::timestamp_t timestamp) const {
+            const size_t index = lower_bound(timestamp);
+            if(index < view_size && (*this)[index].timestamp == timestamp) return index;
+            return CandleRing<CANDLE>::NONE;
+        }
+    };
+
+    /** \brief Построитель снимков истории баров
+     *
+     * Хранит блоки последнего снимка и при следующем запросе копирует
+     * только новые бары и блок с последним баром, который мог измениться.
+     * Полностью перестраивает блоки, только если изменились более старые бары.
+     * Методы вызываются под той же блокировкой, что и изменения буфера баров
+     */
+    template<class CANDLE>
+    class CandleViewBuilder {
+    private:
+        using view_t = CandleView<CANDLE>;
+        static const size_t CHUNK_SIZE = view_t::CHUNK_SIZE;
+
+        std::vector<typename view_t::chunk_ptr> chunks;
+        std::shared_ptr<const view_t> view;
+        uint64_t chunk_base = 0;
+        uint64_t synced_end = 0;        /**< Сквозной номер за последним баром в блоках */
+        uint64_t layout_version = 0;
+        uint64_t update_count = 0;
+        bool is_init = false;
+
+    public:
+
+        /** \brief Получить снимок, соответствующий текущему состоянию буфера
+         * \param ring Буфер баров
+         * \return Снимок истории баров
+         */
+        std::shared_ptr<const view_t> sync(const CandleRing<CANDLE> &ring) {
+            const uint64_t begin = ring.get_front_sequence();
+            const uint64_t end = begin + ring.size();
+            if(is_init && view && update_count == ring.get_update_count() &&
+                layout_version == ring.get_layout_version() &&
+                view->first == begin && synced_end == end) {
+                return view;
+            }
+
+            if(!is_init || layout_version != ring.get_layout_version() || begin > synced_end) {
+                /* сквозные номера больше не соответствуют блокам, строим заново */
+                chunks.clear();
+                chunk_base = begin;
+                synced_end = begin;
+                layout_version = ring.get_layout_version();
+                is_init = true;
+            }
+
+            /* удаляем блоки, все бары которых уже вытеснены */
+            size_t drop = 0;
+            while(drop < chunks.size() && chunk_base + CHUNK_SIZE <= begin) {
+                chunk_base += CHUNK_SIZE;
+                ++drop;
+            }
+            if(drop > 0) chunks.erase(chunks.begin(), chunks.begin() + drop);
+            if(chunks.empty()) {
+                chunk_base = begin;
+                if(synced_end < begin) synced_end = begin;
+            }
+
+            /* последний бар прошлого снимка мог измениться, копируем начиная с него */
+            uint64_t from = synced_end > begin ? synced_end - 1 : begin;
+            if(from < chunk_base) from = chunk_base;
+            while(from < end) {
+                const size_t chunk_index = (size_t)((from - chunk_base) / CHUNK_SIZE);
+                const uint64_t chunk_first = chunk_base + (uint64_t)chunk_index * CHUNK_SIZE;
+                const uint64_t chunk_last = std::min(end, chunk_first + CHUNK_SIZE);
+                std::shared_ptr<typename view_t::chunk_t> chunk = std::make_shared<typename view_t::chunk_t>();
+                chunk->reserve(CHUNK_SIZE);
+                if(chunk_index < chunks.size()) {
+                    /* начало блока не изменилось */
+                    const typename view_t::chunk_t &old_chunk = *chunks[chunk_index];
+                    const size_t keep = (size_t)(from - chunk_first);
+                    chunk->insert(chunk->end(), old_chunk.begin(), old_chunk.begin() + std::min(keep, old_chunk.size()));
+                }
+                /* бары, которые уже вытеснены из буфера, в блоке не нужны, но место под них держим */
+                while(chunk_first + chunk->size() < begin) chunk->push_back(CANDLE());
+                for(uint64_t n = chunk_first + chunk->size(); n < chunk_last; ++n) {
+                    chunk->push_back(ring[(size_t)(n - begin)]);
+                }
+                if(chunk_index < chunks.size()) chunks[chunk_index] = chunk;
+                else chunks.push_back(chunk);
+                from = chunk_last;
+            }
+            synced_end = end;
+            update_count = ring.get_update_count();
+
+            std::shared_ptr<view_t> new_view = std::make_shared<view_t>();
+            new_view->chunks = chunks;
+            new_view->chunk_base = chunk_base;
+            new_view->first = begin;
+            new_view->view_size = ring.size();
+            new_view->period = ring.get_period();
+            view = new_view;
+            return view;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_VIEW_HPP_INCLUDED
@@ -0,0 +1,240 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_DISPATCH_QUEUE_HPP_INCLUDED
+#define BINOMO_CPP_API_DISPATCH_QUEUE_HPP_INCLUDED
+
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace binomo_api {
+
+    /** \brief Режим переполнения очереди доставки событий
+     */
+    enum DispatchOverflowType {
+        OVERFLOW_BLOCK = 0,         /**< Ждать, пока в очереди не появится место */
+        OVERFLOW_DROP_OLDEST = 1,   /**< Вытеснить самое старое событие */
+        OVERFLOW_CONFLATE = 2,      /**< Заменять события с одинаковым ключом, при переполнении ждать */
+    };
+
+    /** \brief Состояние очереди доставки событий
+     */
+    class DispatchStats {
+    public:
+        size_t size = 0;            /**< Количество событий в очереди */
+        size_t max_size = 0;        /**< Наибольшее количество событий в очереди за все время */
+        size_t capacity = 0;        /**< Размер очереди */
+        uint64_t dropped = 0;       /**< Количество вытесненных событий */
+        uint64_t conflated = 0;     /**< Количество событий, замененных более новыми */
+    };
+
+    /** \brief Ограниченная очередь доставки событий с отдельным потоком
+     *
+     * События кладутся в кольцевой буфер фиксированного размера
+     * и передаются обработчику из одного потока доставки в порядке поступления.
+     * Поток доставки забирает из буфера сразу все накопившиеся события,
+     * поэтому блокировка выполняется один раз на пакет.
+     * Что делать при переполнении, задает режим:
+     * OVERFLOW_BLOCK - ждать места, OVERFLOW_DROP_OLDEST - вытеснить самое старое событие,
+     * OVERFLOW_CONFLATE - заменить еще не доставленное событие с тем же ключом.
+     * Тип EVENT должен иметь методы get_key() - ключ объединения событий
+     * и is_conflatable() - можно ли заменять событие более новым.
+     * Событие, которое заменять нельзя, отменяет замену для своего ключа,
+     * поэтому порядок событий с одним ключом сохраняется
+     */
+    template<class EVENT>
+    class DispatchQueue {
+    public:
+        using handler_t = std::function<void(const EVENT &event)>;
+
+    private:
+        std::vector<EVENT> buffer;
+        uint64_t head = 0;                              /**< Номер первого недоставленного события */
+        uint64_t tail = 0;                              /**< Номер следующего события */
+        std::unordered_map<uint64_t, uint64_t> pending; /**< Номер недоставленного события по ключу, для объединения */
+        int overflow_mode = OVERFLOW_BLOCK;
+        DispatchStats stats;
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+        std::condition_variable idle;
+        std::thread thread;
+        handler_t handler = nullptr;
+        bool is_stop = false;
+        bool is_busy = false;
+        std::atomic<bool> is_running = ATOMIC_VAR_INIT(false);
+
+        void run() {
+            std::vector<EVENT> events;
+            while(true) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    is_busy = false;
+                    idle.notify_all();
+                    not_empty.wait(lock, [&]() {
+                        return is_stop || head != tail;
+                    });
+                    /* при остановке сначала доставляем очередь */
+                    if(head == tail) return;
+                    const size_t capacity = buffer.size();
+                    while(head != tail) {
+                        events.push_back(buffer[head % capacity]);
+                        ++head;
+                    }
+                    stats.size = 0;
+                    is_busy = true;
+                }
+                not_full.notify_all();
+                for(const EVENT &event : events) {
+                    handler(event);
+                }
+                events.clear();
+            }
+        }
+
+    public:
+
+        DispatchQueue() {};
+
+        DispatchQueue(const DispatchQueue&) = delete;
+        DispatchQueue &operator=(const DispatchQueue&) = delete;
+
+        ~DispatchQueue() {
+            stop();
+        }
+
+        /** \brief Запустить поток доставки
+         * \param capacity Размер очереди
+         * \param mode Режим переполнения, см. DispatchOverflowType
+         * \param user_handler Обработчик события, вызывается в потоке доставки
+         * \return Вернет false, если очередь уже запущена или параметры неверны
+         */
+        bool start(const size_t capacity, const int mode, const handler_t &user_handler) {
+            if(thread.joinable() || capacity == 0 || user_handler == nullptr) return false;
+            if(mode < OVERFLOW_BLOCK || mode > OVERFLOW_CONFLATE) return false;
+            buffer.assign(capacity, EVENT());
+            head = tail = 0;
+            pending.clear();
+            overflow_mode = mode;
+            stats = DispatchStats();
+            stats.capacity = capacity;
+            handler = user_handler;
+            is_stop = false;
+            is_busy = false;
+            thread = std::thread(&DispatchQueue::run, this);
+            is_running = true;
+            return true;
+        }
+
+        /** \brief Добавить событие
+         *
+         * В режимах OVERFLOW_BLOCK и OVERFLOW_CONFLATE при переполнении ждет,
+         * поэтому вызывать метод нужно без блокировок, которые может взять обработчик
+         * \param event Событие
+         */
+        void push(const EVENT &event) {
+            std::unique_lock<std::mutex> lock(mutex);
+            const size_t capacity = buffer.size();
+            if(overflow_mode == OVERFLOW_CONFLATE) {
+                const uint64_t key = event.get_key();
+                if(event.is_conflatable()) {
+                    auto it = pending.find(key);
+                    if(it != pending.end() && it->second >= head) {
+                        buffer[it->second % capacity] = event;
+                        ++stats.conflated;
+                        return;
+                    }
+                } else {
+                    pending.erase(key);
+                }
+            }
+            if(tail - head == capacity) {
+                if(overflow_mode == OVERFLOW_DROP_OLDEST) {
+                    ++head;
+                    ++stats.dropped;
+                } else {
+                    not_full.wait(lock, [&]() {
+                        return is_stop || tail - head < capacity;
+                    });
+                    if(is_stop) return;
+                }
+            }
+            if(overflow_mode == OVERFLOW_CONFLATE && event.is_conflatable()) {
+                pending[event.get_key()] = tail;
+            }
+            buffer[tail % capacity] = event;
+            ++tail;
+            stats.size = tail - head;
+            if(stats.size > stats.max_size) stats.max_size = stats.size;
+            lock.unlock();
+            not_empty.notify_one();
+        }
+
+        /** \brief Подождать, пока все события не будут доставлены
+         *
+         * Нельзя вызывать из обработчика
+         */
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            idle.wait(lock, [&]() {
+                return is_stop || (head == tail && !is_busy);
+            });
+        }
+
+        /** \brief Остановить поток доставки
+         *
+         * События, которые уже в очереди, будут доставлены
+         */
+        void stop() {
+            is_running = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_stop = true;
+            }
+            not_empty.notify_all();
+            not_full.notify_all();
+            if(thread.joinable()) thread.join();
+            idle.notify_all();
+        }
+
+        /** \brief Получить состояние очереди
+         */
+        DispatchStats get_stats() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+
+        /** \brief Проверить, запущена ли очередь
+         */
+        inline bool running() const {
+            return is_running;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_DISPATCH_QUEUE_HPP_INCLUDED
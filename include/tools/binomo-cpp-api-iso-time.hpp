@@ -0,0 +1,184 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_ISO_TIME_HPP_INCLUDED
+#define BINOMO_CPP_API_ISO_TIME_HPP_INCLUDED
+
+#include <xtime.hpp>
+#include <string>
+#include <cstring>
+
+namespace binomo_api {
+
+    /** \brief Декодер даты в формате ISO 8601
+     *
+     * Декодер рассчитан на фиксированный формат брокера YYYY-MM-DDTHH:MM:SS.ffffffZ.
+     * Метка времени начала дня и метка времени последней секунды запоминаются,
+     * поэтому для строк с той же датой разбирается только время,
+     * а для строк с той же секундой - только дробная часть.
+     * Декодер не потокобезопасен, у каждого потока должен быть свой экземпляр.
+     */
+    class IsoTimeDecoder {
+    private:
+        static const size_t DATE_SIZE = 10;         /**< Длина части YYYY-MM-DD */
+        static const size_t DATE_TIME_SIZE = 19;    /**< Длина части YYYY-MM-DDTHH:MM:SS */
+
+        char last_date_time[DATE_TIME_SIZE];
+        xtime::timestamp_t last_day_timestamp = 0;
+        xtime::timestamp_t last_timestamp = 0;
+        bool is_date = false;
+        bool is_date_time = false;
+
+        static inline bool is_digit(const char c) {
+            return c >= '0' && c <= '9';
+        }
+
+        static inline uint32_t get_2(const char *s) {
+            return (uint32_t)(s[0] - '0') * 10 + (uint32_t)(s[1] - '0');
+        }
+
+        /** \brief Разобрать время дня HH:MM:SS
+         * \param s Указатель на начало времени
+         * \param seconds Количество секунд от начала дня
+         * \return Вернет true в случае успеха
+         */
+        static inline bool decode_time(const char *s, uint32_t &seconds) {
+            if(s[2] != ':' || s[5] != ':') return false;
+            if(!is_digit(s[0]) || !is_digit(s[1]) ||
+                !is_digit(s[3]) || !is_digit(s[4]) ||
+                !is_digit(s[6]) || !is_digit(s[7])) return false;
+            const uint32_t hour = get_2(s);
+            const uint32_t minute = get_2(s + 3);
+            const uint32_t second = get_2(s + 6);
+            if(hour > 23 || minute > 59 || second > 59) return false;
+            seconds = hour * xtime::SECONDS_IN_HOUR + minute * xtime::SECONDS_IN_MINUTE + second;
+            return true;
+        }
+
+        /** \brief Разобрать дату YYYY-MM-DD
+         * \param s Указатель на начало даты
+         * \param timestamp Метка времени начала дня
+         * \return Вернет true в случае успеха
+         */
+        static inline bool decode_date(const char *s, xtime::timestamp_t &timestamp) {
+            if(s[4] != '-' || s[7] != '-') return false;
+            if(!is_digit(s[0]) || !is_digit(s[1]) || !is_digit(s[2]) || !is_digit(s[3]) ||
+                !is_digit(s[5]) || !is_digit(s[6]) ||
+                !is_digit(s[8]) || !is_digit(s[9])) return false;
+            const uint32_t year = get_2(s) * 100 + get_2(s + 2);
+            const uint32_t month = get_2(s + 5);
+            const uint32_t day = get_2(s + 8);
+            if(month < 1 || month > 12 || day < 1 || day > 31) return false;
+            timestamp = xtime::get_timestamp(day, month, year);
+            return true;
+        }
+
+        /** \brief Разобрать дробную часть секунды
+         * \param s Указатель на символ после секунд
+         * \param size Количество символов до конца строки
+         * \return Дробная часть секунды
+         */
+        static inline double decode_fraction(const char *s, const size_t size) {
+            if(size < 2 || s[0] != '.') return 0.0;
+            uint32_t value = 0;
+            uint32_t scale = 1;
+            /* больше 9 знаков в double все равно не поместится в метку времени */
+            const size_t max_size = size < 10 ? size : 10;
+            for(size_t i = 1; i < max_size && is_digit(s[i]); ++i) {
+                value = value * 10 + (uint32_t)(s[i] - '0');
+                scale *= 10;
+            }
+            return (double)value / (double)scale;
+        }
+
+    public:
+
+        IsoTimeDecoder() {};
+
+        /** \brief Декодировать дату и время
+         * \param str Строка с датой в формате YYYY-MM-DDTHH:MM:SS.ffffffZ, может не заканчиваться нулевым символом
+         * \param size Длина строки
+         * \param timestamp Метка времени (без дробной части)
+         * \return Вернет true в случае успеха
+         */
+        inline bool decode(const char *str, const size_t size, xtime::timestamp_t &timestamp) {
+            if(size < DATE_TIME_SIZE || str[10] != 'T') return false;
+            /* та же секунда, что и в прошлый раз */
+            if(is_date_time && std::memcmp(str, last_date_time, DATE_TIME_SIZE) == 0) {
+                timestamp = last_timestamp;
+                return true;
+            }
+            is_date_time = false;
+            if(!is_date || std::memcmp(str, last_date_time, DATE_SIZE) != 0) {
+                is_date = false;
+                if(!decode_date(str, last_day_timestamp)) return false;
+                is_date = true;
+            }
+            uint32_t seconds = 0;
+            if(!decode_time(str + DATE_SIZE + 1, seconds)) {
+                /* дата в буфере может не совпадать с last_day_timestamp */
+                std::memcpy(last_date_time, str, DATE_SIZE);
+                return false;
+            }
+            std::memcpy(last_date_time, str, DATE_TIME_SIZE);
+            last_timestamp = last_day_timestamp + seconds;
+            is_date_time = true;
+            timestamp = last_timestamp;
+            return true;
+        }
+
+        /** \brief Декодировать дату и время с дробной частью секунды
+         * \param str Строка с датой в формате YYYY-MM-DDTHH:MM:SS.ffffffZ, может не заканчиваться нулевым символом
+         * \param size Длина строки
+         * \param ftimestamp Метка времени с дробной частью
+         * \return Вернет true в случае успеха
+         */
+        inline bool decode(const char *str, const size_t size, xtime::ftimestamp_t &ftimestamp) {
+            xtime::timestamp_t timestamp = 0;
+            if(!decode(str, size, timestamp)) return false;
+            ftimestamp = (xtime::ftimestamp_t)timestamp +
+                decode_fraction(str + DATE_TIME_SIZE, size - DATE_TIME_SIZE);
+            return true;
+        }
+
+        /** \brief Декодировать дату и время
+         * \param str Строка с датой в формате YYYY-MM-DDTHH:MM:SS.ffffffZ
+         * \param timestamp Метка времени (без дробной части)
+         * \return Вернет true в случае успеха
+         */
+        inline bool decode(const std::string &str, xtime::timestamp_t &timestamp) {
+            return decode(str.data(), str.size(), timestamp);
+        }
+
+        /** \brief Декодировать дату и время с дробной частью секунды
+         * \param str Строка с датой в формате YYYY-MM-DDTHH:MM:SS.ffffffZ
+         * \param ftimestamp Метка времени с дробной частью
+         * \return Вернет true в случае успеха
+         */
+        inline bool decode(const std::string &str, xtime::ftimestamp_t &ftimestamp) {
+            return decode(str.data(), str.size(), ftimestamp);
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_ISO_TIME_HPP_INCLUDED
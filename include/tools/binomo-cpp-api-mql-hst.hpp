@@ -42,8 +42,20 @@ namespace binomo_api {
         int64_t timezone = 0;
         size_t offset = 0;
         xtime::timestamp_t last_timestamp = 0;
+        xtime::timestamp_t closed_timestamp = 0;   /**< Метка времени последнего закрытого бара, он лежит перед offset */
         bool is_open = false;
 
+        static const size_t RECORD_SIZE = sizeof(uint32_t) + 5 * sizeof(double);  /**< Размер бара в файле */
+
+        inline void write_candle(const CANDLE &candle) {
+            write_u32((uint32_t)((int64_t)candle.timestamp + timezone));
+            write_double(common::get_candle_price(candle.open, digits));
+            write_double(common::get_candle_price(candle.low, digits));
+            write_double(common::get_candle_price(candle.high, digits));
+            write_double(common::get_candle_price(candle.close, digits));
+            write_double((double)candle.volume);
+        }
+
         inline void seek(const unsigned long offset, const std::ios::seekdir &origin = std::ios::beg) {
             file.clear();
             file.seekp(offset, origin);
@@ -120,12 +132,7 @@ namespace binomo_api {
         void update_candle(const CANDLE &candle) {
             if(!is_open) return;
             seek(offset);
-            write_u32((uint32_t)((int64_t)candle.timestamp + timezone));
-            write_double(candle.open);
-            write_double(candle.low);
-            write_double(candle.high);
-            write_double(candle.close);
-            write_double(candle.volume);
+            write_candle(candle);
             file.flush();
             last_timestamp = candle.timestamp;
         }
@@ -148,14 +155,10 @@ namespace binomo_api {
                 last_candle.volume = candle.volume;
             }
             new_candle = last_candle;
+            new_candle.timestamp = candle.timestamp;
 
             seek(offset);
-            write_u32((uint32_t)((int64_t)candle.timestamp + timezone));
-            write_double(new_candle.open);
-            write_double(new_candle.low);
-            write_double(new_candle.high);
-            write_double(new_candle.close);
-            write_double(new_candle.volume);
+            write_candle(new_candle);
             file.flush();
             last_timestamp = candle.timestamp;
         }
@@ -164,12 +167,33 @@ namespace binomo_api {
             if(!is_open) return;
             update_candle(candle);
             offset = file.tellp();
+            closed_timestamp = candle.timestamp;
         }
 
         void add_new_candle_with_memory(const CANDLE &candle) {
             if(!is_open) return;
             update_candle_with_memory(candle);
             offset = file.tellp();
+            closed_timestamp = candle.timestamp;
+        }
+
+        /** \brief Исправить уже записанный бар
+         *
+         * Исправить можно текущий бар или последний закрытый бар,
+         * более старые бары не изменяются
+         * \param candle Исправленный бар целиком
+         */
+        void correct_candle(const CANDLE &candle) {
+            if(!is_open) return;
+            if(candle.timestamp == last_timestamp && candle.timestamp != closed_timestamp) {
+                update_candle_with_memory(candle);
+                return;
+            }
+            if(candle.timestamp != closed_timestamp || offset < RECORD_SIZE) return;
+            seek(offset - RECORD_SIZE);
+            write_candle(candle);
+            file.flush();
+            if(last_candle.timestamp == candle.timestamp) last_candle = candle;
         }
 
         inline xtime::timestamp_t get_last_timestamp() {
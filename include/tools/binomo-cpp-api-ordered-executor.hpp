@@ -0,0 +1,310 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_ORDERED_EXECUTOR_HPP_INCLUDED
+#define BINOMO_CPP_API_ORDERED_EXECUTOR_HPP_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace binomo_api {
+
+    /** \brief Пул потоков с сохранением порядка задач по ключу и перехватом работы
+     *
+     * Задачи с одним ключом (например, символ и период бара) попадают в одну цепочку
+     * и выполняются строго по порядку, а разные цепочки выполняются параллельно.
+     * В отличие от ShardPool цепочка не привязана к потоку: готовая цепочка
+     * ставится в очередь потока, а свободный поток забирает цепочки из очередей
+     * других потоков, поэтому один медленный ключ не задерживает остальные.
+     * Цепочка одновременно выполняется только одним потоком.
+     * Ключ - это номер цепочки, количество цепочек задается при запуске,
+     * поэтому разные ключи никогда не попадают в одну цепочку
+     */
+    template<class TASK>
+    class OrderedExecutor {
+    public:
+        using handler_t = std::function<void(const TASK &task)>;
+
+    private:
+        /** \brief Цепочка задач одного ключа
+         */
+        class Strand {
+        public:
+            std::mutex mutex;
+            std::vector<TASK> queue;
+            bool is_scheduled = false;  /**< Цепочка в очереди потока или выполняется */
+        };
+
+        /** \brief Поток пула и его очередь готовых цепочек
+         */
+        class Worker {
+        public:
+            std::mutex mutex;
+            std::deque<Strand*> ready;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Strand>> strands;
+        std::vector<std::unique_ptr<Worker>> workers;
+        handler_t handler = nullptr;
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+        std::condition_variable idle_cv;
+        std::atomic<size_t> ready_size = ATOMIC_VAR_INIT(0);    /**< Количество цепочек в очередях потоков */
+        std::atomic<size_t> pending_size = ATOMIC_VAR_INIT(0);  /**< Количество невыполненных задач */
+        std::atomic<size_t> next_worker = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> steals = ATOMIC_VAR_INIT(0);
+        std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+
+        /** \brief Номер потока пула, в котором выполняется код, или workers.size()
+         */
+        inline size_t get_current_worker() const {
+            const OrderedExecutor *executor = current_executor();
+            return executor == this ? current_worker_index() : workers.size();
+        }
+
+        static inline const OrderedExecutor *&current_executor() {
+            static thread_local const OrderedExecutor *executor = nullptr;
+            return executor;
+        }
+
+        static inline size_t &current_worker_index() {
+            static thread_local size_t index = 0;
+            return index;
+        }
+
+        /** \brief Поставить цепочку в очередь потока
+         *
+         * Поток пула ставит цепочку в свою очередь, остальные потоки - по кругу
+         */
+        void schedule(Strand *strand) {
+            size_t index = get_current_worker();
+            if(index >= workers.size()) index = next_worker++ % workers.size();
+            {
+                std::lock_guard<std::mutex> lock(workers[index]->mutex);
+                /* счетчик растет раньше, чем цепочку можно забрать, иначе он может уйти ниже нуля */
+                ++ready_size;
+                workers[index]->ready.push_back(strand);
+            }
+            {
+                /* блокировка нужна, чтобы поток не пропустил уведомление */
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+            }
+            sleep_cv.notify_one();
+        }
+
+        /** \brief Забрать готовую цепочку: сначала из своей очереди, затем из чужих
+         */
+        Strand *take(const size_t index) {
+            {
+                Worker &worker = *workers[index];
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                if(!worker.ready.empty()) {
+                    Strand *strand = worker.ready.front();
+                    worker.ready.pop_front();
+                    return strand;
+                }
+            }
+            const size_t size = workers.size();
+            for(size_t n = 1; n < size; ++n) {
+                Worker &victim = *workers[(index + n) % size];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if(victim.ready.empty()) continue;
+                /* чужую очередь забираем с конца, владелец берет с начала */
+                Strand *strand = victim.ready.back();
+                victim.ready.pop_back();
+                ++steals;
+                return strand;
+            }
+            return nullptr;
+        }
+
+        /** \brief Выполнить накопившиеся задачи цепочки
+         */
+        void execute(Strand *strand, std::vector<TASK> &tasks) {
+            {
+                std::lock_guard<std::mutex> lock(strand->mutex);
+                tasks.swap(strand->queue);
+            }
+            for(const TASK &task : tasks) {
+                handler(task);
+            }
+            const size_t tasks_size = tasks.size();
+            tasks.clear();
+            bool is_reschedule = false;
+            {
+                std::lock_guard<std::mutex> lock(strand->mutex);
+                if(strand->queue.empty()) strand->is_scheduled = false;
+                else is_reschedule = true;
+            }
+            /* новые задачи цепочки ставим в конец очереди, чтобы не задерживать другие цепочки */
+            if(is_reschedule) schedule(strand);
+            if(pending_size.fetch_sub(tasks_size) == tasks_size) {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                idle_cv.notify_all();
+            }
+        }
+
+        void run(const size_t index) {
+            current_executor() = this;
+            current_worker_index() = index;
+            std::vector<TASK> tasks;
+            while(true) {
+                Strand *strand = take(index);
+                if(strand == nullptr) {
+                    std::unique_lock<std::mutex> lock(sleep_mutex);
+                    sleep_cv.wait(lock, [&]() {
+                        return is_stop || ready_size > 0;
+                    });
+                    /* при остановке сначала дорабатываем очереди,
+                     * цепочку с новыми задачами поток ставит в свою очередь и сам ее выполнит
+                     */
+                    if(is_stop && ready_size == 0) break;
+                    continue;
+                }
+                --ready_size;
+                execute(strand, tasks);
+            }
+            current_executor() = nullptr;
+        }
+
+    public:
+
+        OrderedExecutor() {};
+
+        OrderedExecutor(const OrderedExecutor&) = delete;
+        OrderedExecutor &operator=(const OrderedExecutor&) = delete;
+
+        ~OrderedExecutor() {
+            stop();
+        }
+
+        /** \brief Запустить потоки пула
+         * \param num_workers Количество потоков
+         * \param num_strands Количество цепочек, ключи задач от 0 до num_strands - 1
+         * \param user_handler Обработчик задачи, вызывается в потоке пула
+         * \return Вернет false, если пул уже запущен или параметры неверны
+         */
+        bool start(const size_t num_workers, const size_t num_strands, const handler_t &user_handler) {
+            if(!workers.empty() || num_workers == 0 || num_strands == 0 || user_handler == nullptr) return false;
+            handler = user_handler;
+            is_stop = false;
+            ready_size = 0;
+            pending_size = 0;
+            steals = 0;
+            if(strands.size() != num_strands) {
+                strands.clear();
+                for(size_t i = 0; i < num_strands; ++i) {
+                    strands.push_back(std::unique_ptr<Strand>(new Strand()));
+                }
+            }
+            for(size_t i = 0; i < num_workers; ++i) {
+                workers.push_back(std::unique_ptr<Worker>(new Worker()));
+            }
+            for(size_t i = 0; i < num_workers; ++i) {
+                workers[i]->thread = std::thread(&OrderedExecutor::run, this, i);
+            }
+            return true;
+        }
+
+        /** \brief Добавить задачу
+         *
+         * Не ждет выполнения задач, поэтому метод можно вызывать под блокировками
+         * \param key Ключ задачи (номер цепочки), задачи с одним ключом выполняются по порядку
+         * \param task Задача
+         */
+        void push(const size_t key, const TASK &task) {
+            Strand &strand = *strands[key];
+            bool is_schedule = false;
+            {
+                std::lock_guard<std::mutex> lock(strand.mutex);
+                strand.queue.push_back(task);
+                ++pending_size;
+                if(!strand.is_scheduled) {
+                    strand.is_scheduled = true;
+                    is_schedule = true;
+                }
+            }
+            if(is_schedule) schedule(&strand);
+        }
+
+        /** \brief Подождать, пока все задачи не будут выполнены
+         *
+         * Нельзя вызывать из обработчика
+         */
+        void wait() {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            idle_cv.wait(lock, [&]() {
+                return pending_size == 0;
+            });
+        }
+
+        /** \brief Остановить потоки пула
+         *
+         * Задачи, которые уже в очереди, будут выполнены
+         */
+        void stop() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+                is_stop = true;
+            }
+            sleep_cv.notify_all();
+            for(auto &worker : workers) {
+                if(worker->thread.joinable()) worker->thread.join();
+            }
+            workers.clear();
+        }
+
+        /** \brief Получить количество невыполненных задач
+         */
+        inline size_t get_pending() const {
+            return pending_size;
+        }
+
+        /** \brief Получить количество цепочек, перехваченных из очередей других потоков
+         */
+        inline uint64_t get_steals() const {
+            return steals;
+        }
+
+        /** \brief Получить количество потоков
+         */
+        inline size_t size() const {
+            return workers.size();
+        }
+
+        /** \brief Проверить, запущен ли пул
+         */
+        inline bool running() const {
+            return !workers.empty();
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_ORDERED_EXECUTOR_HPP_INCLUDED
@@ -0,0 +1,105 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_SEQLOCK_HPP_INCLUDED
+#define BINOMO_CPP_API_SEQLOCK_HPP_INCLUDED
+
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+namespace binomo_api {
+
+    /** \brief Значение, опубликованное через seqlock
+     *
+     * Один писатель, любое количество читателей. Запись никогда не ждет,
+     * чтение не блокирует писателя и повторяется, только если попало на запись.
+     * Значение хранится в атомарных словах, поэтому гонки данных нет.
+     * Тип T должен быть тривиально копируемым
+     */
+    template<class T>
+    class SeqLock {
+    private:
+        static_assert(std::is_trivially_copyable<T>::value, "SeqLock: T must be trivially copyable");
+        static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+        std::atomic<uint32_t> sequence;
+        std::array<std::atomic<uint64_t>, WORDS> words;
+
+    public:
+
+        SeqLock() : sequence(0) {
+            for(auto &word : words) word.store(0, std::memory_order_relaxed);
+        };
+
+        SeqLock(const SeqLock&) = delete;
+        SeqLock &operator=(const SeqLock&) = delete;
+
+        /** \brief Опубликовать значение
+         *
+         * Одновременно может писать только один поток
+         * \param value Значение
+         */
+        void store(const T &value) {
+            uint64_t buffer[WORDS] = {};
+            std::memcpy(buffer, &value, sizeof(T));
+            const uint32_t start = sequence.load(std::memory_order_relaxed);
+            sequence.store(start + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for(size_t i = 0; i < WORDS; ++i) {
+                words[i].store(buffer[i], std::memory_order_relaxed);
+            }
+            sequence.store(start + 2, std::memory_order_release);
+        }
+
+        /** \brief Прочитать значение
+         * \return Последнее опубликованное значение
+         */
+        T load() const {
+            uint64_t buffer[WORDS];
+            uint32_t start = 0;
+            while(true) {
+                start = sequence.load(std::memory_order_acquire);
+                if(start & 1) continue;
+                for(size_t i = 0; i < WORDS; ++i) {
+                    buffer[i] = words[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(sequence.load(std::memory_order_relaxed) == start) break;
+            }
+            T value;
+            std::memcpy(&value, buffer, sizeof(T));
+            return value;
+        }
+
+        /** \brief Проверить, было ли опубликовано значение
+         */
+        inline bool published() const {
+            return sequence.load(std::memory_order_acquire) != 0;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_SEQLOCK_HPP_INCLUDED
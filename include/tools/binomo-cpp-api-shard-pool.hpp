@@ -0,0 +1,171 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_SHARD_POOL_HPP_INCLUDED
+#define BINOMO_CPP_API_SHARD_POOL_HPP_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+namespace binomo_api {
+
+    /** \brief Пул потоков с разбиением задач по ключу
+     *
+     * Задачи с одинаковым ключом (например, идентификатором символа) всегда
+     * попадают в один и тот же поток и выполняются в порядке поступления.
+     * Поток забирает из очереди сразу все накопившиеся задачи,
+     * поэтому блокировка выполняется один раз на пакет задач.
+     */
+    template<class TASK>
+    class ShardPool {
+    public:
+        using handler_t = std::function<void(const size_t worker_index, std::vector<TASK> &tasks)>;
+
+    private:
+        /** \brief Поток пула и его очередь
+         */
+        class Worker {
+        public:
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::condition_variable idle_cv;
+            std::vector<TASK> queue;
+            std::thread thread;
+            bool is_busy = false;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        handler_t handler = nullptr;
+        std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+
+        void run(const size_t index) {
+            Worker &worker = *workers[index];
+            std::vector<TASK> tasks;
+            while(true) {
+                {
+                    std::unique_lock<std::mutex> lock(worker.mutex);
+                    worker.is_busy = false;
+                    worker.idle_cv.notify_all();
+                    worker.cv.wait(lock, [&]() {
+                        return is_stop || !worker.queue.empty();
+                    });
+                    /* при остановке сначала дорабатываем очередь */
+                    if(worker.queue.empty()) return;
+                    tasks.swap(worker.queue);
+                    worker.is_busy = true;
+                }
+                handler(index, tasks);
+                tasks.clear();
+            }
+        }
+
+    public:
+
+        ShardPool() {};
+
+        ShardPool(const ShardPool&) = delete;
+        ShardPool &operator=(const ShardPool&) = delete;
+
+        ~ShardPool() {
+            stop();
+        }
+
+        /** \brief Запустить потоки пула
+         * \param num_workers Количество потоков
+         * \param user_handler Обработчик пакета задач, вызывается в потоке пула
+         * \return Вернет false, если пул уже запущен или параметры неверны
+         */
+        bool start(const size_t num_workers, const handler_t &user_handler) {
+            if(!workers.empty() || num_workers == 0 || user_handler == nullptr) return false;
+            handler = user_handler;
+            is_stop = false;
+            for(size_t i = 0; i < num_workers; ++i) {
+                workers.push_back(std::unique_ptr<Worker>(new Worker()));
+            }
+            for(size_t i = 0; i < num_workers; ++i) {
+                workers[i]->thread = std::thread(&ShardPool::run, this, i);
+            }
+            return true;
+        }
+
+        /** \brief Добавить задачу
+         * \param key Ключ задачи, задачи с одним ключом выполняются по порядку
+         * \param task Задача
+         */
+        void push(const uint32_t key, const TASK &task) {
+            Worker &worker = *workers[key % workers.size()];
+            {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.queue.push_back(task);
+            }
+            worker.cv.notify_one();
+        }
+
+        /** \brief Подождать, пока все задачи не будут выполнены
+         */
+        void wait() {
+            for(auto &worker : workers) {
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                worker->idle_cv.wait(lock, [&]() {
+                    return worker->queue.empty() && !worker->is_busy;
+                });
+            }
+        }
+
+        /** \brief Остановить потоки пула
+         *
+         * Задачи, которые уже в очереди, будут выполнены
+         */
+        void stop() {
+            is_stop = true;
+            for(auto &worker : workers) {
+                /* блокировка нужна, чтобы поток не пропустил уведомление */
+                std::lock_guard<std::mutex> lock(worker->mutex);
+            }
+            for(auto &worker : workers) {
+                worker->cv.notify_all();
+                if(worker->thread.joinable()) worker->thread.join();
+            }
+            workers.clear();
+        }
+
+        /** \brief Получить количество потоков
+         */
+        inline size_t size() const {
+            return workers.size();
+        }
+
+        /** \brief Проверить, запущен ли пул
+         */
+        inline bool running() const {
+            return !workers.empty();
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_SHARD_POOL_HPP_INCLUDED
@@ -0,0 +1,158 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_STREAM_POLICY_HPP_INCLUDED
+#define BINOMO_CPP_API_STREAM_POLICY_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <atomic>
+#include <cmath>
+#include <type_traits>
+
+namespace binomo_api {
+
+    /** \brief Политика без подсчета объема
+     *
+     * Политики объема задаются параметром шаблона BinomoApiPriceStream.
+     * init() вызывается для нового бара, update() - для каждого следующего тика бара
+     */
+    class VolumeNonePolicy {
+    public:
+        template<class CANDLE>
+        inline void init(CANDLE &candle) const {
+            candle.volume = 0;
+        }
+
+        template<class CANDLE, class PRICE>
+        inline void update(
+                CANDLE &/*candle*/,
+                const CANDLE &/*last_candle*/,
+                const PRICE /*price*/,
+                const uint32_t /*precision*/) const {
+        }
+    };
+
+    /** \brief Политика подсчета тиков
+     */
+    class VolumeTickPolicy {
+    public:
+        template<class CANDLE>
+        inline void init(CANDLE &candle) const {
+            candle.volume = 1;
+        }
+
+        template<class CANDLE, class PRICE>
+        inline void update(
+                CANDLE &candle,
+                const CANDLE &/*last_candle*/,
+                const PRICE /*price*/,
+                const uint32_t /*precision*/) const {
+            candle.volume += 1;
+        }
+    };
+
+    /** \brief Политика взвешенного подсчета тиков
+     *
+     * Объем растет на изменение цены в пунктах
+     */
+    class VolumeWeightPolicy {
+    public:
+        template<class CANDLE>
+        inline void init(CANDLE &candle) const {
+            candle.volume = 0;
+        }
+
+        template<class CANDLE, class PRICE>
+        inline void update(
+                CANDLE &candle,
+                const CANDLE &last_candle,
+                const PRICE price,
+                const uint32_t precision) const {
+            /* пока объема нет, считаем от цены закрытия последнего бара */
+            const PRICE close = candle.volume == 0 ? last_candle.close : candle.close;
+            const PRICE diff = std::abs(price - close);
+            candle.volume += common::get_candle_points(diff, precision);
+        }
+    };
+
+    /** \brief Политика объема, выбираемая во время работы
+     *
+     * Режим задается через set_mode(): 0 - отключено, 1 - подсчет тиков, 2 - взвешенный подсчет тиков
+     */
+    class VolumeRuntimePolicy {
+    private:
+        std::atomic<int> mode = ATOMIC_VAR_INIT(0);
+    public:
+        static const int MODE_NO_VOLUME = 0;
+        static const int MODE_VOLUME_ACC = 1;
+        static const int MODE_VOLUME_WEIGHT_ACC = 2;
+
+        inline void set_mode(const int value) {
+            mode = value;
+        }
+
+        template<class CANDLE>
+        inline void init(CANDLE &candle) const {
+            if(mode == MODE_VOLUME_ACC) VolumeTickPolicy().init(candle);
+            else VolumeNonePolicy().init(candle);
+        }
+
+        template<class CANDLE, class PRICE>
+        inline void update(
+                CANDLE &candle,
+                const CANDLE &last_candle,
+                const PRICE price,
+                const uint32_t precision) const {
+            const int value = mode;
+            if(value == MODE_VOLUME_ACC) {
+                VolumeTickPolicy().update(candle, last_candle, price, precision);
+            } else
+            if(value == MODE_VOLUME_WEIGHT_ACC) {
+                VolumeWeightPolicy().update(candle, last_candle, price, precision);
+            }
+        }
+    };
+
+    /** \brief Приемник по умолчанию
+     *
+     * Бары и тики передаются в функции обратного вызова потока
+     * on_candle, on_candle_id, on_tick и on_ticks.
+     * Свой приемник должен иметь методы on_candle(symbol_id, candle, period, close_candle)
+     * для баров или on_tick(tick) и on_ticks(ticks, ticks_size, receive_timestamp) для тиков.
+     * Метод on_candle_correction(symbol_id, candle, period) для исправлений закрытых баров
+     * необязателен. Вызовы приемника не проходят через std::function и могут быть встроены компилятором
+     */
+    class FunctionSink {};
+
+    /** \brief Проверка наличия у приемника метода on_candle_correction
+     */
+    template<class SINK, class CANDLE, class = void>
+    class HasCandleCorrection : public std::false_type {};
+
+    template<class SINK, class CANDLE>
+    class HasCandleCorrection<SINK, CANDLE, std::void_t<decltype(std::declval<SINK&>().on_candle_correction(
+        std::declval<uint32_t>(), std::declval<const CANDLE&>(), std::declval<uint32_t>()))>> : public std::true_type {};
+
+}
+
+#endif // BINOMO_CPP_API_STREAM_POLICY_HPP_INCLUDED
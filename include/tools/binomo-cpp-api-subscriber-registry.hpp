@@ -0,0 +1,370 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_SUBSCRIBER_REGISTRY_HPP_INCLUDED
+#define BINOMO_CPP_API_SUBSCRIBER_REGISTRY_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <atomic>
+#include <algorithm>
+
+namespace binomo_api {
+
+    /** \brief Реестр подписчиков на события потока котировок
+     *
+     * Каждый подписчик задает фильтр: символ, период и флаг "только закрытые бары".
+     * При изменении подписок заранее строится таблица маршрутов, в которой
+     * для каждой пары символ-период уже собран список подходящих обработчиков,
+     * поэтому событие передается только нужным обработчикам без перебора подписок.
+     * Таблица не изменяется после построения и заменяется целиком,
+     * поэтому передача событий не блокирует подписку и может идти из нескольких потоков
+     * \tparam CANDLE Тип бара
+     */
+    template<class CANDLE = common::Candle>
+    class SubscriberRegistry {
+    public:
+        static constexpr uint32_t ANY_SYMBOL = 0xFFFFFFFF; /**< Любой символ */
+        static constexpr uint32_t ANY_PERIOD = 0;          /**< Любой период */
+
+        using candle_handler_t = std::function<void(
+            const uint32_t symbol_id,
+            const CANDLE &candle,
+            const uint32_t period,
+            const bool close_candle)>;
+
+        using correction_handler_t = std::function<void(
+            const uint32_t symbol_id,
+            const CANDLE &candle,
+            const uint32_t period)>;
+
+        using tick_handler_t = std::function<void(const common::StreamTick &tick)>;
+
+        /** \brief Фильтр подписки
+         */
+        class Filter {
+        public:
+            uint32_t symbol_id = ANY_SYMBOL;    /**< Идентификатор символа или ANY_SYMBOL */
+            uint32_t period = ANY_PERIOD;       /**< Период или ANY_PERIOD */
+            bool closed_only = false;           /**< Только закрытые бары */
+
+            Filter() {};
+
+            Filter(const uint32_t user_symbol_id, const uint32_t user_period, const bool user_closed_only = false) :
+                symbol_id(user_symbol_id), period(user_period), closed_only(user_closed_only) {};
+        };
+
+    private:
+        static const int CANDLE_SUBSCRIPTION = 0;
+        static const int CORRECTION_SUBSCRIPTION = 1;
+        static const int TICK_SUBSCRIPTION = 2;
+
+        /** \brief Подписка
+         */
+        class Subscription {
+        public:
+            uint64_t id = 0;
+            int type = CANDLE_SUBSCRIPTION;
+            Filter filter;
+            std::shared_ptr<const candle_handler_t> on_candle;
+            std::shared_ptr<const correction_handler_t> on_correction;
+            std::shared_ptr<const tick_handler_t> on_tick;
+        };
+
+        /** \brief Обработчики пары символ-период
+         */
+        class Route {
+        public:
+            std::vector<std::shared_ptr<const candle_handler_t>> on_update;  /**< Обработчики незакрытого бара */
+            std::vector<std::shared_ptr<const candle_handler_t>> on_close;   /**< Обработчики закрытого бара */
+            std::vector<std::shared_ptr<const correction_handler_t>> on_correction;
+
+            inline bool empty() const {
+                return on_update.empty() && on_close.empty() && on_correction.empty();
+            }
+        };
+
+        /** \brief Таблица маршрутов
+         *
+         * Ключ - символ и период, ANY_SYMBOL означает символы без своих подписок,
+         * ANY_PERIOD - периоды без своих подписок
+         */
+        class RouteTable {
+        public:
+            std::unordered_map<uint64_t, Route> routes;
+            std::unordered_map<uint32_t, std::vector<std::shared_ptr<const tick_handler_t>>> tick_routes;
+
+            static inline uint64_t get_key(const uint32_t symbol_id, const uint32_t period) {
+                return ((uint64_t)symbol_id << 32) | period;
+            }
+
+            /** \brief Найти маршрут
+             *
+             * Если для пары символ-период нет маршрута, значит символ или период
+             * не упоминается в подписках, и подходят маршруты с ANY_SYMBOL или ANY_PERIOD
+             */
+            inline const Route *find(const uint32_t symbol_id, const uint32_t period) const {
+                const uint64_t keys[4] = {
+                    get_key(symbol_id, period),
+                    get_key(symbol_id, ANY_PERIOD),
+                    get_key(ANY_SYMBOL, period),
+                    get_key(ANY_SYMBOL, ANY_PERIOD)
+                };
+                for(const uint64_t key : keys) {
+                    auto it = routes.find(key);
+                    if(it != routes.end()) return &it->second;
+                }
+                return nullptr;
+            }
+
+            inline const std::vector<std::shared_ptr<const tick_handler_t>> *find_ticks(const uint32_t symbol_id) const {
+                auto it = tick_routes.find(symbol_id);
+                if(it == tick_routes.end()) it = tick_routes.find(ANY_SYMBOL);
+                if(it == tick_routes.end()) return nullptr;
+                return &it->second;
+            }
+        };
+
+        std::mutex subscriptions_mutex;
+        std::vector<Subscription> subscriptions;
+        uint64_t last_id = 0;
+        std::shared_ptr<const RouteTable> table;
+        std::atomic<bool> is_candle_routes = ATOMIC_VAR_INIT(false);
+        std::atomic<bool> is_tick_routes = ATOMIC_VAR_INIT(false);
+
+        static inline bool match(const uint32_t filter_value, const uint32_t value, const uint32_t any_value) {
+            return filter_value == any_value || filter_value == value;
+        }
+
+        /** \brief Построить таблицу маршрутов
+         *
+         * Маршруты строятся для всех сочетаний упомянутых в подписках символов
+         * и периодов, включая ANY_SYMBOL и ANY_PERIOD. Вызывается под блокировкой подписок
+         */
+        void rebuild() {
+            std::vector<uint32_t> symbols = {ANY_SYMBOL};
+            std::vector<uint32_t> periods = {ANY_PERIOD};
+            std::vector<uint32_t> tick_symbols = {ANY_SYMBOL};
+            for(const Subscription &subscription : subscriptions) {
+                if(subscription.type == TICK_SUBSCRIPTION) {
+                    tick_symbols.push_back(subscription.filter.symbol_id);
+                    continue;
+                }
+                symbols.push_back(subscription.filter.symbol_id);
+                periods.push_back(subscription.filter.period);
+            }
+            auto unique = [](std::vector<uint32_t> &values) {
+                std::sort(values.begin(), values.end());
+                values.erase(std::unique(values.begin(), values.end()), values.end());
+            };
+            unique(symbols);
+            unique(periods);
+            unique(tick_symbols);
+
+            std::shared_ptr<RouteTable> new_table = std::make_shared<RouteTable>();
+            for(const uint32_t symbol_id : symbols) {
+                for(const uint32_t period : periods) {
+                    Route route;
+                    for(const Subscription &subscription : subscriptions) {
+                        if(subscription.type == TICK_SUBSCRIPTION) continue;
+                        if(!match(subscription.filter.symbol_id, symbol_id, ANY_SYMBOL)) continue;
+                        if(!match(subscription.filter.period, period, ANY_PERIOD)) continue;
+                        if(subscription.type == CORRECTION_SUBSCRIPTION) {
+                            route.on_correction.push_back(subscription.on_correction);
+                            continue;
+                        }
+                        if(!subscription.filter.closed_only) route.on_update.push_back(subscription.on_candle);
+                        route.on_close.push_back(subscription.on_candle);
+                    }
+                    if(route.empty()) continue;
+                    new_table->routes[RouteTable::get_key(symbol_id, period)] = std::move(route);
+                }
+            }
+            for(const uint32_t symbol_id : tick_symbols) {
+                std::vector<std::shared_ptr<const tick_handler_t>> handlers;
+                for(const Subscription &subscription : subscriptions) {
+                    if(subscription.type != TICK_SUBSCRIPTION) continue;
+                    if(!match(subscription.filter.symbol_id, symbol_id, ANY_SYMBOL)) continue;
+                    handlers.push_back(subscription.on_tick);
+                }
+                if(handlers.empty()) continue;
+                new_table->tick_routes[symbol_id] = std::move(handlers);
+            }
+            const bool is_candles = !new_table->routes.empty();
+            const bool is_ticks = !new_table->tick_routes.empty();
+            std::atomic_store(&table, std::shared_ptr<const RouteTable>(new_table));
+            is_candle_routes = is_candles;
+            is_tick_routes = is_ticks;
+        }
+
+        uint64_t add(Subscription &subscription) {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            subscription.id = ++last_id;
+            subscriptions.push_back(subscription);
+            rebuild();
+            return subscription.id;
+        }
+
+    public:
+
+        SubscriberRegistry() {};
+
+        SubscriberRegistry(const SubscriberRegistry&) = delete;
+        SubscriberRegistry &operator=(const SubscriberRegistry&) = delete;
+
+        /** \brief Подписаться на бары
+         * \param filter Фильтр: символ, период, только закрытые бары
+         * \param handler Обработчик бара
+         * \return Идентификатор подписки или 0, если обработчик не задан
+         */
+        uint64_t subscribe_candles(const Filter &filter, const candle_handler_t &handler) {
+            if(handler == nullptr) return 0;
+            Subscription subscription;
+            subscription.type = CANDLE_SUBSCRIPTION;
+            subscription.filter = filter;
+            subscription.on_candle = std::make_shared<const candle_handler_t>(handler);
+            return add(subscription);
+        }
+
+        /** \brief Подписаться на исправления закрытых баров
+         * \param filter Фильтр: символ и период, флаг закрытых баров не используется
+         * \param handler Обработчик исправленного бара
+         * \return Идентификатор подписки или 0, если обработчик не задан
+         */
+        uint64_t subscribe_candle_corrections(const Filter &filter, const correction_handler_t &handler) {
+            if(handler == nullptr) return 0;
+            Subscription subscription;
+            subscription.type = CORRECTION_SUBSCRIPTION;
+            subscription.filter = filter;
+            subscription.on_correction = std::make_shared<const correction_handler_t>(handler);
+            return add(subscription);
+        }
+
+        /** \brief Подписаться на тики
+         * \param symbol_id Идентификатор символа или ANY_SYMBOL
+         * \param handler Обработчик тика
+         * \return Идентификатор подписки или 0, если обработчик не задан
+         */
+        uint64_t subscribe_ticks(const uint32_t symbol_id, const tick_handler_t &handler) {
+            if(handler == nullptr) return 0;
+            Subscription subscription;
+            subscription.type = TICK_SUBSCRIPTION;
+            subscription.filter.symbol_id = symbol_id;
+            subscription.on_tick = std::make_shared<const tick_handler_t>(handler);
+            return add(subscription);
+        }
+
+        /** \brief Отписаться
+         *
+         * Обработчик может быть вызван еще раз, если событие уже передается в другом потоке
+         * \param id Идентификатор подписки
+         * \return Вернет false, если подписки нет
+         */
+        bool unsubscribe(const uint64_t id) {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            auto it = std::find_if(subscriptions.begin(), subscriptions.end(),
+                [&](const Subscription &subscription) {
+                    return subscription.id == id;
+                });
+            if(it == subscriptions.end()) return false;
+            subscriptions.erase(it);
+            rebuild();
+            return true;
+        }
+
+        /** \brief Удалить все подписки
+         */
+        void clear() {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            subscriptions.clear();
+            rebuild();
+        }
+
+        /** \brief Получить количество подписок
+         */
+        size_t size() {
+            std::lock_guard<std::mutex> lock(subscriptions_mutex);
+            return subscriptions.size();
+        }
+
+        /** \brief Передать бар подписчикам
+         * \param symbol_id Идентификатор символа
+         * \param candle Бар
+         * \param period Период
+         * \param close_candle Флаг закрытия бара
+         */
+        inline void dispatch_candle(
+                const uint32_t symbol_id,
+                const CANDLE &candle,
+                const uint32_t period,
+                const bool close_candle) const {
+            if(!is_candle_routes) return;
+            const std::shared_ptr<const RouteTable> current_table = std::atomic_load(&table);
+            if(!current_table) return;
+            const Route *route = current_table->find(symbol_id, period);
+            if(route == nullptr) return;
+            for(const auto &handler : (close_candle ? route->on_close : route->on_update)) {
+                (*handler)(symbol_id, candle, period, close_candle);
+            }
+        }
+
+        /** \brief Передать исправленный бар подписчикам
+         * \param symbol_id Идентификатор символа
+         * \param candle Исправленный бар
+         * \param period Период
+         */
+        inline void dispatch_candle_correction(
+                const uint32_t symbol_id,
+                const CANDLE &candle,
+                const uint32_t period) const {
+            if(!is_candle_routes) return;
+            const std::shared_ptr<const RouteTable> current_table = std::atomic_load(&table);
+            if(!current_table) return;
+            const Route *route = current_table->find(symbol_id, period);
+            if(route == nullptr) return;
+            for(const auto &handler : route->on_correction) {
+                (*handler)(symbol_id, candle, period);
+            }
+        }
+
+        /** \brief Передать тик подписчикам
+         * \param tick Тик
+         */
+        inline void dispatch_tick(const common::StreamTick &tick) const {
+            if(!is_tick_routes) return;
+            const std::shared_ptr<const RouteTable> current_table = std::atomic_load(&table);
+            if(!current_table) return;
+            const auto *handlers = current_table->find_ticks(tick.symbol_id);
+            if(handlers == nullptr) return;
+            for(const auto &handler : *handlers) {
+                (*handler)(tick);
+            }
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_SUBSCRIBER_REGISTRY_HPP_INCLUDED
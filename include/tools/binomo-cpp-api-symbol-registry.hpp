@@ -0,0 +1,245 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_SYMBOL_REGISTRY_HPP_INCLUDED
+#define BINOMO_CPP_API_SYMBOL_REGISTRY_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <cstring>
+
+namespace binomo_api {
+
+    /** \brief Реестр символов
+     *
+     * Реестр один раз, при подписке, назначает символам плотные целочисленные
+     * идентификаторы 0, 1, 2... Дальше по потоку котировок передается
+     * только идентификатор, а строки нужны лишь на границах API.
+     * Поиск по RIC и по имени символа выполняется без блокировок и без
+     * выделения памяти, регистрация новых символов защищена мьютексом.
+     * Записи реестра никогда не удаляются и не перемещаются, поэтому
+     * ссылки на имена символов остаются действительными все время жизни реестра.
+     */
+    class SymbolRegistry {
+    public:
+        static const uint32_t MAX_SYMBOLS = 64;         /**< Максимальное количество символов */
+        static const uint32_t NONE = 0xFFFFFFFF;        /**< Идентификатор отсутствующего символа */
+
+    private:
+        static const uint32_t TABLE_SIZE = 256;         /**< Размер хеш-таблицы, степень двойки */
+        static const uint32_t MAX_KEY_SIZE = 24;        /**< Максимальная длина ключа */
+
+        /** \brief Ячейка хеш-таблицы
+         */
+        class Slot {
+        public:
+            char key[MAX_KEY_SIZE];
+            uint32_t key_size = 0;
+            std::atomic<uint32_t> id;                   /**< Идентификатор + 1, 0 - ячейка пустая */
+
+            Slot() : id(0) {};
+        };
+
+        std::array<Slot, TABLE_SIZE> ric_table;
+        std::array<Slot, TABLE_SIZE> name_table;
+
+        std::array<std::string, MAX_SYMBOLS> names;     /**< Нормализованные имена символов */
+        std::array<std::string, MAX_SYMBOLS> rics;      /**< RIC символов */
+        std::array<uint32_t, MAX_SYMBOLS> precisions;   /**< Точность котировок символов */
+        std::atomic<uint32_t> symbols_size;
+        std::mutex registry_mutex;
+
+        static inline uint32_t get_hash(const char *key, const size_t size) {
+            /* FNV-1a */
+            uint32_t hash = 2166136261u;
+            for(size_t i = 0; i < size; ++i) {
+                hash ^= (uint8_t)key[i];
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        static uint32_t find(
+                const std::array<Slot, TABLE_SIZE> &table,
+                const char *key,
+                const size_t size) {
+            if(size == 0 || size > MAX_KEY_SIZE) return NONE;
+            uint32_t index = get_hash(key, size) & (TABLE_SIZE - 1);
+            for(uint32_t n = 0; n < TABLE_SIZE; ++n) {
+                const Slot &slot = table[index];
+                const uint32_t id = slot.id.load(std::memory_order_acquire);
+                if(id == 0) return NONE;
+                if(slot.key_size == size && std::memcmp(slot.key, key, size) == 0) return id - 1;
+                index = (index + 1) & (TABLE_SIZE - 1);
+            }
+            return NONE;
+        }
+
+        static void insert(
+                std::array<Slot, TABLE_SIZE> &table,
+                const std::string &key,
+                const uint32_t id) {
+            uint32_t index = get_hash(key.data(), key.size()) & (TABLE_SIZE - 1);
+            while(table[index].id.load(std::memory_order_relaxed) != 0) {
+                index = (index + 1) & (TABLE_SIZE - 1);
+            }
+            Slot &slot = table[index];
+            std::memcpy(slot.key, key.data(), key.size());
+            slot.key_size = key.size();
+            slot.id.store(id + 1, std::memory_order_release);
+        }
+
+    public:
+
+        SymbolRegistry() : symbols_size(0) {
+            precisions.fill(0);
+        };
+
+        SymbolRegistry(const SymbolRegistry&) = delete;
+        SymbolRegistry &operator=(const SymbolRegistry&) = delete;
+
+        /** \brief Зарегистрировать символ
+         *
+         * Повторная регистрация вернет уже назначенный идентификатор.
+         * Всего можно зарегистрировать не более MAX_SYMBOLS символов
+         * \param symbol Имя символа, например EURUSD или EUR/USD
+         * \param id Идентификатор символа или NONE
+         * \return Код ошибки: INVALID_PARAMETER - символ не существует,
+         * SYMBOL_LIMIT_REACHED - уже зарегистрировано MAX_SYMBOLS символов
+         */
+        int add(const std::string &symbol, uint32_t &id) {
+            id = NONE;
+            const std::string name = common::normalize_symbol_name(symbol);
+            auto it_ric = common::normalize_name_to_ric.find(name);
+            if(it_ric == common::normalize_name_to_ric.end()) return common::INVALID_PARAMETER;
+            if(name.size() > MAX_KEY_SIZE || it_ric->second.size() > MAX_KEY_SIZE) return common::INVALID_PARAMETER;
+
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            const uint32_t found_id = find(name_table, name.data(), name.size());
+            if(found_id != NONE) {
+                id = found_id;
+                return common::OK;
+            }
+            const uint32_t new_id = symbols_size.load(std::memory_order_relaxed);
+            if(new_id >= MAX_SYMBOLS) return common::SYMBOL_LIMIT_REACHED;
+            id = new_id;
+
+            names[id] = name;
+            rics[id] = it_ric->second;
+            auto it_precision = common::normalize_name_to_precision.find(name);
+            if(it_precision != common::normalize_name_to_precision.end()) {
+                precisions[id] = it_precision->second;
+            }
+            symbols_size.store(id + 1, std::memory_order_release);
+            insert(name_table, names[id], id);
+            insert(ric_table, rics[id], id);
+            return common::OK;
+        }
+
+        /** \brief Зарегистрировать символ
+         * \param symbol Имя символа, например EURUSD или EUR/USD
+         * \return Идентификатор символа или NONE, если символ не существует
+         * или уже зарегистрировано MAX_SYMBOLS символов
+         */
+        inline uint32_t add(const std::string &symbol) {
+            uint32_t id = NONE;
+            add(symbol, id);
+            return id;
+        }
+
+        /** \brief Найти идентификатор символа по RIC
+         *
+         * Метод не выделяет память и не использует блокировки
+         * \param ric RIC символа, например EURO
+         * \param size Длина RIC
+         * \return Идентификатор символа или NONE
+         */
+        inline uint32_t find_ric(const char *ric, const size_t size) const {
+            return find(ric_table, ric, size);
+        }
+
+        /** \brief Найти идентификатор символа по нормализованному имени
+         *
+         * Метод не выделяет память и не использует блокировки
+         * \param name Нормализованное имя символа, например EURUSD
+         * \param size Длина имени
+         * \return Идентификатор символа или NONE
+         */
+        inline uint32_t find_name(const char *name, const size_t size) const {
+            return find(name_table, name, size);
+        }
+
+        /** \brief Найти идентификатор символа по имени
+         * \param symbol Имя символа, например EURUSD, eurusd или EUR/USD
+         * \return Идентификатор символа или NONE
+         */
+        uint32_t get_id(const std::string &symbol) const {
+            const uint32_t id = find(name_table, symbol.data(), symbol.size());
+            if(id != NONE) return id;
+            const std::string name = common::normalize_symbol_name(symbol);
+            return find(name_table, name.data(), name.size());
+        }
+
+        /** \brief Получить имя символа
+         * \param id Идентификатор символа
+         * \return Нормализованное имя символа
+         */
+        inline const std::string &get_name(const uint32_t id) const {
+            return names[id];
+        }
+
+        /** \brief Получить RIC символа
+         * \param id Идентификатор символа
+         * \return RIC символа
+         */
+        inline const std::string &get_ric(const uint32_t id) const {
+            return rics[id];
+        }
+
+        /** \brief Получить точность котировок символа
+         * \param id Идентификатор символа
+         * \return Количество знаков после запятой
+         */
+        inline uint32_t get_precision(const uint32_t id) const {
+            return precisions[id];
+        }
+
+        /** \brief Получить количество зарегистрированных символов
+         *
+         * Идентификаторы символов лежат в диапазоне [0, size())
+         */
+        inline uint32_t size() const {
+            return symbols_size.load(std::memory_order_acquire);
+        }
+
+        /** \brief Проверить идентификатор символа
+         */
+        inline bool check_id(const uint32_t id) const {
+            return id < size();
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_SYMBOL_REGISTRY_HPP_INCLUDED
@@ -0,0 +1,178 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_TICK_AGGREGATOR_HPP_INCLUDED
+#define BINOMO_CPP_API_TICK_AGGREGATOR_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include "binomo-cpp-api-stream-policy.hpp"
+#include <vector>
+#include <algorithm>
+
+namespace binomo_api {
+
+    /** \brief Пакетная сборка баров из записанных тиков
+     *
+     * Тики одного символа передаются колонками: массив меток времени и массив цен.
+     * За один проход по тикам собираются бары сразу нескольких периодов
+     * по тем же правилам, что и в потоке котировок (см. BinomoApiPriceStream::aggregate_tick):
+     * 0-секунда относится к предыдущему бару, метка времени бара - время его окончания,
+     * опоздавший тик обновляет свой бар, а если бара нет - добавляет его на свое место.
+     * Бары дописываются в выходные массивы, поэтому длинную запись
+     * можно обрабатывать частями, вызывая aggregate() несколько раз
+     * \tparam CANDLE Тип бара: common::Candle или common::FixedCandle
+     * \tparam VOLUME Политика объема, как у BinomoApiPriceStream
+     */
+    template<class CANDLE = common::Candle, class VOLUME = VolumeRuntimePolicy>
+    class TickAggregator {
+    private:
+        using price_type = decltype(CANDLE::close);
+
+        VOLUME volume_policy;
+
+        /** \brief Обработать тик, который не попал в последний бар периода
+         */
+        inline void aggregate_slow(
+                std::vector<CANDLE> &candles,
+                const uint32_t period,
+                const xtime::timestamp_t timestamp,
+                const price_type price,
+                const uint32_t precision) {
+            const xtime::timestamp_t bar_timestamp = (timestamp - (timestamp % period)) + period;
+            if(candles.empty() || bar_timestamp > candles.back().timestamp) {
+                CANDLE candle(price,price,price,price,bar_timestamp);
+                volume_policy.init(candle);
+                candles.push_back(candle);
+                return;
+            }
+            /* опоздавший тик */
+            auto it = std::lower_bound(candles.begin(), candles.end(), bar_timestamp,
+                [](const CANDLE &candle, const xtime::timestamp_t value) {
+                    return candle.timestamp < value;
+                });
+            if(it == candles.end() || it->timestamp != bar_timestamp) {
+                CANDLE candle(price,price,price,price,bar_timestamp);
+                volume_policy.init(candle);
+                candles.insert(it, candle);
+                return;
+            }
+            CANDLE &candle = *it;
+            volume_policy.update(candle, candles.back(), price, precision);
+            candle.close = price;
+            if(price > candle.high) candle.high = price;
+            if(price < candle.low) candle.low = price;
+        }
+
+    public:
+
+        TickAggregator() {};
+
+        /** \brief Установить режим подсчета объема
+         *
+         * Только для политики VolumeRuntimePolicy
+         * \param value 0 - отключено, 1 - подсчет тиков, 2 - взвешенный подсчет тиков
+         */
+        void set_volume_mode(const int value) {
+            volume_policy.set_mode(value);
+        }
+
+        /** \brief Собрать бары из тиков
+         * \param timestamps Метки времени тиков
+         * \param prices Цены тиков
+         * \param size Количество тиков
+         * \param precision Точность котировок символа
+         * \param periods Периоды баров
+         * \param periods_size Количество периодов
+         * \param output Массивы баров по периодам, бары дописываются в конец
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int aggregate(
+                const xtime::ftimestamp_t *timestamps,
+                const double *prices,
+                const size_t size,
+                const uint32_t precision,
+                const uint32_t *periods,
+                const size_t periods_size,
+                std::vector<CANDLE> *output) {
+            for(size_t n = 0; n < periods_size; ++n) {
+                if(periods[n] == 0) return common::INVALID_PARAMETER;
+            }
+            if(size == 0) return common::OK;
+
+            /* место под бары оцениваем по первому и последнему тику */
+            const xtime::ftimestamp_t duration = timestamps[size - 1] - timestamps[0];
+            if(duration > 0) {
+                for(size_t n = 0; n < periods_size; ++n) {
+                    output[n].reserve(output[n].size() + (size_t)(duration / periods[n]) + 2);
+                }
+            }
+
+            for(size_t i = 0; i < size; ++i) {
+                /* 0-секунда относится к предыдущему бару */
+                const xtime::timestamp_t timestamp = (xtime::timestamp_t)(timestamps[i] - 1);
+                price_type price;
+                common::set_candle_price(price, prices[i], precision);
+                for(size_t n = 0; n < periods_size; ++n) {
+                    std::vector<CANDLE> &candles = output[n];
+                    const uint32_t period = periods[n];
+                    /* тик последнего бара, без деления */
+                    if(!candles.empty()) {
+                        CANDLE &candle = candles.back();
+                        if(timestamp < candle.timestamp && timestamp + period >= candle.timestamp) {
+                            volume_policy.update(candle, candle, price, precision);
+                            candle.close = price;
+                            if(price > candle.high) candle.high = price;
+                            if(price < candle.low) candle.low = price;
+                            continue;
+                        }
+                    }
+                    aggregate_slow(candles, period, timestamp, price, precision);
+                }
+            }
+            return common::OK;
+        }
+
+        /** \brief Собрать бары из тиков
+         * \param timestamps Метки времени тиков
+         * \param prices Цены тиков
+         * \param precision Точность котировок символа
+         * \param periods Периоды баров
+         * \param output Массивы баров по периодам, бары дописываются в конец
+         * \return Код ошибки, вернет 0 если все в порядке
+         */
+        int aggregate(
+                const std::vector<xtime::ftimestamp_t> &timestamps,
+                const std::vector<double> &prices,
+                const uint32_t precision,
+                const std::vector<uint32_t> &periods,
+                std::vector<std::vector<CANDLE>> &output) {
+            if(timestamps.size() != prices.size()) return common::INVALID_PARAMETER;
+            output.resize(periods.size());
+            return aggregate(
+                timestamps.data(), prices.data(), timestamps.size(), precision,
+                periods.data(), periods.size(), output.data());
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_TICK_AGGREGATOR_HPP_INCLUDED